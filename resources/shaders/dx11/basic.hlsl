@@ -1,13 +1,14 @@
 #include "common.hlsl"
-#include "variables.hlsl"
 
 PSInput VS_Main(VSInput input)
 {
     PSInput output;
-    output.clipPos = mul(float4(input.pos, 1.0f), v_mvp);
-    output.worldPos = mul(float4(input.pos, 1.0f), v_world).xyz;
-    output.worldNormal = mul(float4(input.normal, 0.f), v_world).xyz;
+    float3x4 world = getWorld(input);
+    output.clipPos = getClipPosition(input);
+    output.worldPos = mul(world, float4(input.pos, 1.0f));
+    output.worldNormal = mul(world, float4(input.normal, 0.f));
     output.uv = input.uv;
+    output.color = getObjectColor(input);
     return output; 
 }
 
@@ -15,7 +16,7 @@ float4 PS_Main(PSInput input) : SV_TARGET
 { 
     float2 uv = input.uv;
     float4 textureSample = diffuseTexture.Sample(texSampler, input.uv);
-    float4 color = textureSample * v_objectColor;
+    float4 color = textureSample * input.color;
     if (all(textureSample == float4(0,0,0,0))) {
         color = float4(1, 0, 1, 1);
     }
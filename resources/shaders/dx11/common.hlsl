@@ -1,3 +1,5 @@
+#include "variables.hlsl"
+
 Texture2D diffuseTexture : register(t0);
 SamplerState texSampler : register(s0);
 
@@ -6,6 +8,13 @@ struct VSInput
     float3 pos : POSITION;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
+#ifdef INSTANCED
+    // per-instance stream, matches Shaders::InstanceVariables
+    float4 instanceWorld0 : INSTANCE_WORLD0;
+    float4 instanceWorld1 : INSTANCE_WORLD1;
+    float4 instanceWorld2 : INSTANCE_WORLD2;
+    float4 instanceColor : INSTANCE_COLOR;
+#endif
 };
 
 struct PSInput
@@ -14,4 +23,38 @@ struct PSInput
     float3 worldPos : WPOSITION;
     float3 worldNormal : NORMAL;
     float2 uv : TEXCOORD;
+    float4 color : COLOR;
 };
+
+// object variables come from the object constant buffer, or from the instance stream in the INSTANCED variant
+#ifdef INSTANCED
+float3x4 getWorld(VSInput input)
+{
+    return float3x4(input.instanceWorld0, input.instanceWorld1, input.instanceWorld2);
+}
+
+float4 getObjectColor(VSInput input)
+{
+    return input.instanceColor;
+}
+
+float4 getClipPosition(VSInput input)
+{
+    return mul(float4(mul(getWorld(input), float4(input.pos, 1.0f)), 1.0f), v_viewProjection);
+}
+#else
+float3x4 getWorld(VSInput input)
+{
+    return v_world;
+}
+
+float4 getObjectColor(VSInput input)
+{
+    return v_objectColor;
+}
+
+float4 getClipPosition(VSInput input)
+{
+    return mul(float4(input.pos, 1.0f), v_mvp);
+}
+#endif
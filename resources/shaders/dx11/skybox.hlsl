@@ -20,7 +20,7 @@ PSInput VS_Main(VSInput input)
 {
     PSInput output;
 
-    matrix view = v_mvp;
+    matrix view = v_viewProjection;
     view[3][0] = 0.0;
     view[3][1] = 0.0;
     view[3][2] = 0.0;
@@ -1,11 +1,11 @@
 #include "common.hlsl"
-#include "variables.hlsl"
 
 PSInput VS_Main(VSInput input)
 {
     PSInput output;
-    output.clipPos = mul(float4(input.pos, 1.0f), v_mvp);
+    output.clipPos = getClipPosition(input);
     output.uv = input.uv;
+    output.color = getObjectColor(input);
     return output; 
 }
 
@@ -14,7 +14,7 @@ float4 PS_Main(PSInput input) : SV_TARGET
     float2 uv = input.uv;
     float4 textureColor = diffuseTexture.Sample(texSampler, uv);
     if (all(textureColor == float4(0, 0, 0, 0)))
-        return v_objectColor;
-    return textureColor * v_objectColor;
+        return input.color;
+    return textureColor * input.color;
 }
 
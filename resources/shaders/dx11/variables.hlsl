@@ -1,11 +1,21 @@
-cbuffer Variables : register(b0)
+cbuffer FrameVariables : register(b0)
+{
+    float4x4 v_viewProjection;
+    float3 v_cameraPosition;
+    float v_time;
+}
+
+cbuffer LightVariables : register(b1)
 {
-    float4x4 v_world;
-    float4x4 v_mvp;
-    float4 v_objectColor;
     float4 v_lightColor;
     float3 v_lightDirection;
-    float3 v_lightPosition;
-    float v_time;
     int v_lightType;
+    float3 v_lightPosition;
+}
+
+cbuffer ObjectVariables : register(b2)
+{
+    row_major float3x4 v_world;
+    float4x4 v_mvp;
+    float4 v_objectColor;
 }
@@ -63,6 +63,40 @@ T* arrayPush(Array<T>& array, T value)
     return arrayLast(array);
 }
 
+// growing inside an arena: the array is extended in place when it was the last allocation,
+// otherwise it moves and the old storage stays behind until the arena is cleared
+TRIVIAL_TEMPLATE_T(T)
+void arrayReserve(Array<T>& array, size_t capacity, Arena& arena)
+{
+    if (capacity <= array.capacity)
+        return;
+
+    const auto isLastAllocation = array.data && (uint8_t*)(array.data + array.capacity) == arena.buffer + arena.used;
+    if (isLastAllocation)
+    {
+        arenaAlloc(arena, (capacity - array.capacity) * sizeof(T), 1);
+    }
+    else
+    {
+        const auto data = (T*)arenaAlloc(arena, capacity * sizeof(T), alignof(T));
+        if (array.size > 0)
+            memcpy(data, array.data, array.size * sizeof(T));
+        array.data = data;
+    }
+
+    array.capacity = capacity;
+    array.capacityBytes = capacity * sizeof(T);
+}
+
+TRIVIAL_TEMPLATE_T(T)
+T* arrayPush(Array<T>& array, T value, Arena& arena)
+{
+    static constexpr size_t MIN_GROW_CAPACITY = 64;
+    if (array.size == array.capacity)
+        arrayReserve(array, array.capacity ? array.capacity * 2 : MIN_GROW_CAPACITY, arena);
+    return arrayPush(array, value);
+}
+
 TRIVIAL_TEMPLATE_T(T)
 void arrayPop(Array<T>& array)
 {
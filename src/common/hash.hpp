@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+
+#include "utils.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// wyhash-style hashing: bulk data is folded 16 bytes at a time through 64x64->128 multiplies.
+// everything is constexpr so literal names can be hashed at compile time, runtime calls use plain loads
+namespace Hash
+{
+
+static constexpr u64 SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+constexpr void multiply128(u64& a, u64& b)
+{
+    if (!std::is_constant_evaluated())
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        a = _umul128(a, b, &b);
+        return;
+#elif defined(__SIZEOF_INT128__)
+        const auto result = (unsigned __int128)a * b;
+        a = (u64)result;
+        b = (u64)(result >> 64);
+        return;
+#endif
+    }
+
+    const u64 aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    const u64 bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    const u64 loLo = aLo * bLo, hiLo = aHi * bLo, loHi = aLo * bHi, hiHi = aHi * bHi;
+    const u64 cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    a = (cross << 32) | (loLo & 0xFFFFFFFF);
+    b = (hiLo >> 32) + (cross >> 32) + hiHi;
+}
+
+constexpr u64 mix(u64 a, u64 b)
+{
+    multiply128(a, b);
+    return a ^ b;
+}
+
+constexpr u64 read8(const char* p)
+{
+    if (!std::is_constant_evaluated())
+    {
+        u64 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    u64 v = 0;
+    for (int i = 0; i < 8; ++i)
+        v |= (u64)(u8)p[i] << (i * 8);
+    return v;
+}
+
+constexpr u64 read4(const char* p)
+{
+    if (!std::is_constant_evaluated())
+    {
+        u32 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    u64 v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= (u64)(u8)p[i] << (i * 8);
+    return v;
+}
+
+constexpr u64 read3(const char* p, size_t length)
+{
+    return ((u64)(u8)p[0] << 16) | ((u64)(u8)p[length >> 1] << 8) | (u64)(u8)p[length - 1];
+}
+
+}  // namespace Hash
+
+constexpr u64 hashBytes(const char* data, size_t length, u64 seed = 0)
+{
+    using namespace Hash;
+
+    auto p = data;
+    seed ^= mix(seed ^ SECRET[0], SECRET[1]);
+
+    u64 a = 0, b = 0;
+    if (length <= 16)
+    {
+        if (length >= 4)
+        {
+            const auto offset = (length >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + offset);
+            b = (read4(p + length - 4) << 32) | read4(p + length - 4 - offset);
+        }
+        else if (length > 0)
+        {
+            a = read3(p, length);
+        }
+    }
+    else
+    {
+        auto remaining = length;
+        if (remaining > 48)
+        {
+            auto seed1 = seed, seed2 = seed;
+            do
+            {
+                seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+                seed1 = mix(read8(p + 16) ^ SECRET[2], read8(p + 24) ^ seed1);
+                seed2 = mix(read8(p + 32) ^ SECRET[3], read8(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (remaining > 16)
+        {
+            seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        a = read8(p + remaining - 16);
+        b = read8(p + remaining - 8);
+    }
+
+    a ^= SECRET[1];
+    b ^= seed;
+    multiply128(a, b);
+    return mix(a ^ SECRET[0] ^ length, b ^ SECRET[1]);
+}
+
+inline u64 hashBytes(const void* data, size_t length, u64 seed = 0)
+{
+    return hashBytes((const char*)data, length, seed);
+}
+
+// cheap finalizer for integers, handles and pointers
+constexpr u64 hashMix64(u64 value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+constexpr u64 hashCombine(u64 hash, u64 value)
+{
+    return Hash::mix(hash ^ Hash::SECRET[0], value ^ Hash::SECRET[1]);
+}
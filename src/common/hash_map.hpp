@@ -6,21 +6,130 @@
 #include <cstring>
 #include <type_traits>
 
-inline uint32_t hashFunction(const void* data, size_t sizeOfData, uint32_t hash = 2166136261U)
+#include "memory.hpp"
+#include "hash.hpp"
+#include "string.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASH_MAP_SSE2 1
+#include <emmintrin.h>
+#else
+#define HASH_MAP_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// key hashing and comparison hooks, overload these for keys that aren't compared by their bytes
+template <typename K>
+uint64_t mapHashKey(K const& key)
+{
+    if constexpr (std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>)
+    {
+        return hashMix64((uint64_t)key);
+    }
+    else if constexpr (sizeof(K) <= sizeof(uint64_t) && std::has_unique_object_representations_v<K>)
+    {
+        // small padding-free keys like handles fit in one word
+        uint64_t word = 0;
+        memcpy(&word, &key, sizeof(K));
+        return hashMix64(word);
+    }
+    else
+    {
+        return hashBytes(&key, sizeof(K));
+    }
+}
+
+template <typename K>
+bool mapKeysEqual(K const& a, K const& b)
+{
+    return memcmp(&a, &b, sizeof(K)) == 0;
+}
+
+// strings are keyed by their contents, not by the pointer and length
+inline uint64_t mapHashKey(String const& key)
 {
-    const uint8_t* bytes = static_cast<const uint8_t*>(data);
-    for (size_t i = 0; i < sizeOfData; ++i)
-        hash = (hash ^ bytes[i]) * 16777619U;
-    return hash;
+    return strHash(key);
+}
+
+inline bool mapKeysEqual(String const& a, String const& b)
+{
+    return a.length == b.length && (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
 }
 
 #define TRIVIAL_TEMPLATE_KV(k, v)     \
     template <typename K, typename V> \
         requires std::is_trivial_v<k> && std::is_trivial_v<v>
 
-static constexpr float LOAD_FACTOR = 0.7f;
+static constexpr float LOAD_FACTOR = 0.875f;
 static constexpr size_t INITIAL_CAPACITY = 256;
 
+// swiss-table style open addressing: one control byte per slot, scanned a group of 16 at a time.
+// a full slot stores the low 7 bits of its hash (h2), the remaining bits (h1) pick the first group to probe
+namespace HashMapControl
+{
+
+static constexpr int8_t EMPTY = (int8_t)0x80;
+static constexpr int8_t DELETED = (int8_t)0xFE;
+static constexpr size_t GROUP_WIDTH = 16;
+
+inline bool isFull(int8_t control)
+{
+    return control >= 0;
+}
+
+inline size_t h1(uint64_t hash)
+{
+    return (size_t)(hash >> 7);
+}
+
+inline int8_t h2(uint64_t hash)
+{
+    return (int8_t)(hash & 0x7F);
+}
+
+// bit i is set when byte i of the group equals value
+inline uint32_t groupMatch(const int8_t* group, int8_t value)
+{
+#if HASH_MAP_SSE2
+    const auto bytes = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+        mask |= uint32_t(group[i] == value) << i;
+    return mask;
+#endif
+}
+
+// bit i is set when byte i of the group is empty or deleted (both have the sign bit set)
+inline uint32_t groupMatchEmptyOrDeleted(const int8_t* group)
+{
+#if HASH_MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+        mask |= uint32_t(group[i] < 0) << i;
+    return mask;
+#endif
+}
+
+inline uint32_t lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+}  // namespace HashMapControl
+
 TRIVIAL_TEMPLATE_KV(K, V)
 struct HashMap
 {
@@ -28,76 +137,247 @@ struct HashMap
     {
         K key;
         V value;
-        uint32_t hash;
     };
 
+    int8_t* control{};
     Entry* entries{};
     size_t size{};
     size_t capacity{};
+    size_t tombstones{};
+    Arena* arena{};  // malloc when null, arena-backed maps leave their old table in the arena on rehash
+
+    struct Iterator
+    {
+        HashMap* map;
+        size_t index;
+
+        Entry& operator*() const { return map->entries[index]; }
+        Entry* operator->() const { return &map->entries[index]; }
+        bool operator!=(Iterator const& other) const { return index != other.index; }
+        Iterator& operator++()
+        {
+            do
+            {
+                index++;
+            } while (index < map->capacity && !HashMapControl::isFull(map->control[index]));
+            return *this;
+        }
+    };
+
+    Iterator begin()
+    {
+        Iterator iter{this, 0};
+        if (capacity > 0 && !HashMapControl::isFull(control[0]))
+            ++iter;
+        return iter;
+    }
+    Iterator end() { return Iterator{this, capacity}; }
+};
+
+// probing whole groups with a triangular sequence, which visits every group when the group count is a power of two
+struct HashMapProbe
+{
+    size_t groupMask;
+    size_t group;
+    size_t step;
 
-    Entry* begin() { return entries; }
-    const Entry* begin() const { return entries; }
-    Entry* end() { return entries + size; }
-    const Entry* end() const { return entries + size; }
+    size_t offset() const { return group * HashMapControl::GROUP_WIDTH; }
+    void next()
+    {
+        step++;
+        group = (group + step) & groupMask;
+    }
 };
 
+inline HashMapProbe mapProbeStart(uint64_t hash, size_t capacity)
+{
+    const auto groupMask = capacity / HashMapControl::GROUP_WIDTH - 1;
+    return {.groupMask = groupMask, .group = HashMapControl::h1(hash) & groupMask, .step = 0};
+}
+
 TRIVIAL_TEMPLATE_KV(K, V)
-void mapAlloc(HashMap<K, V>& map, size_t capacity = INITIAL_CAPACITY)
+void mapAllocTable(HashMap<K, V>& map, size_t capacity)
 {
-    capacity = capacity == 0 ? 1 : capacity;
-    map.entries = (typename HashMap<K, V>::Entry*)std::malloc(capacity);
-    memset(map.entries, sizeof(HashMap<K, V>::Entry), 0);
+    using Entry = typename HashMap<K, V>::Entry;
+
+    size_t roundedCapacity = HashMapControl::GROUP_WIDTH;
+    while (roundedCapacity < capacity)
+        roundedCapacity *= 2;
+
+    const auto entriesOffset = (roundedCapacity + alignof(Entry) - 1) & ~(alignof(Entry) - 1);
+    const auto totalBytes = entriesOffset + roundedCapacity * sizeof(Entry);
+
+    uint8_t* memory = nullptr;
+    if (map.arena)
+        memory = (uint8_t*)arenaAlloc(*map.arena, totalBytes, alignof(Entry) > 16 ? alignof(Entry) : 16);
+    else
+        memory = (uint8_t*)std::malloc(totalBytes);
+    assert(memory);
+
+    map.control = (int8_t*)memory;
+    map.entries = (Entry*)(memory + entriesOffset);
+    map.capacity = roundedCapacity;
     map.size = 0;
-    map.capacity = capacity;
+    map.tombstones = 0;
+    memset(map.control, (uint8_t)HashMapControl::EMPTY, roundedCapacity);
+}
+
+TRIVIAL_TEMPLATE_KV(K, V)
+void mapAlloc(HashMap<K, V>& map, size_t capacity = INITIAL_CAPACITY, Arena* arena = nullptr)
+{
+    map.arena = arena;
+    mapAllocTable(map, capacity);
+}
+
+TRIVIAL_TEMPLATE_KV(K, V)
+ptrdiff_t mapFindIndex(HashMap<K, V> const& map, K const& key, uint64_t hash)
+{
+    if (!map.control)
+        return -1;
+
+    const auto tag = HashMapControl::h2(hash);
+    for (auto probe = mapProbeStart(hash, map.capacity);; probe.next())
+    {
+        const auto group = map.control + probe.offset();
+
+        for (auto match = HashMapControl::groupMatch(group, tag); match; match &= match - 1)
+        {
+            const auto index = probe.offset() + HashMapControl::lowestBit(match);
+            if (mapKeysEqual(map.entries[index].key, key))
+                return (ptrdiff_t)index;
+        }
+
+        // an empty slot ends the probe sequence, the key would have been placed there
+        if (HashMapControl::groupMatch(group, HashMapControl::EMPTY))
+            return -1;
+    }
+}
+
+// first empty or deleted slot on the probe sequence, the table always has at least one
+TRIVIAL_TEMPLATE_KV(K, V)
+size_t mapFindInsertSlot(HashMap<K, V> const& map, uint64_t hash)
+{
+    for (auto probe = mapProbeStart(hash, map.capacity);; probe.next())
+    {
+        if (const auto match = HashMapControl::groupMatchEmptyOrDeleted(map.control + probe.offset()); match)
+            return probe.offset() + HashMapControl::lowestBit(match);
+    }
+}
+
+TRIVIAL_TEMPLATE_KV(K, V)
+void mapRehash(HashMap<K, V>& map, size_t newCapacity)
+{
+    auto old = map;
+    mapAllocTable(map, newCapacity);
+
+    for (size_t i = 0; i < old.capacity; ++i)
+    {
+        if (!HashMapControl::isFull(old.control[i]))
+            continue;
+
+        const auto hash = mapHashKey(old.entries[i].key);
+        const auto slot = mapFindInsertSlot(map, hash);
+        map.control[slot] = HashMapControl::h2(hash);
+        map.entries[slot] = old.entries[i];
+        map.size++;
+    }
+
+    if (!old.arena)
+        std::free(old.control);
 }
 
 TRIVIAL_TEMPLATE_KV(K, V)
-void mapInsert(HashMap<K, V>& map, K key, V&& value)
+V* mapInsert(HashMap<K, V>& map, K key, V value)
 {
-    if (!map.entries)
+    if (!map.control)
         mapAlloc(map);
 
-    const auto hash = hashFunction((void*)&key, sizeof(K));
-    map.entries[hash & map.capacity - 1] = {key, value, hash};
+    const auto hash = mapHashKey(key);
+    if (const auto existing = mapFindIndex(map, key, hash); existing != -1)
+    {
+        map.entries[existing].value = value;
+        return &map.entries[existing].value;
+    }
+
+    // tombstones count against the load factor since they lengthen probe sequences,
+    // if they make up most of it rehashing at the same capacity is enough
+    if ((float)(map.size + map.tombstones + 1) > (float)map.capacity * LOAD_FACTOR)
+    {
+        const auto grow = map.size + 1 > map.capacity / 2;
+        mapRehash(map, grow ? map.capacity * 2 : map.capacity);
+    }
+
+    const auto slot = mapFindInsertSlot(map, hash);
+    if (map.control[slot] == HashMapControl::DELETED)
+        map.tombstones--;
+
+    map.control[slot] = HashMapControl::h2(hash);
+    map.entries[slot] = {key, value};
+    map.size++;
+
+    return &map.entries[slot].value;
 }
 
 TRIVIAL_TEMPLATE_KV(K, V)
 V* mapAt(HashMap<K, V>& map, K key)
 {
-    if (!map.entries || map.size == 0)
+    if (!map.control || map.size == 0)
         return nullptr;
 
-    const auto hash = hashFunction((void*)&key, sizeof(K));
-    return &map.entries[hash & map.capacity - 1].value;
+    const auto index = mapFindIndex(map, key, mapHashKey(key));
+    return index == -1 ? nullptr : &map.entries[index].value;
 }
 
 TRIVIAL_TEMPLATE_KV(K, V)
-void mapErase(HashMap<K, V>& map, K key)
+bool mapErase(HashMap<K, V>& map, K key)
 {
-    if (!map.entries)
-        return;
+    if (!map.control || map.size == 0)
+        return false;
+
+    const auto index = mapFindIndex(map, key, mapHashKey(key));
+    if (index == -1)
+        return false;
 
-    const auto hash = hashFunction((void*)&key, sizeof(K));
-    map.entries[hash & map.capacity - 1] = {};
+    // a group that still has an empty slot never made a probe continue past it, so the slot can become empty
+    // again. otherwise it has to stay a tombstone to keep later keys reachable
+    const auto groupStart = (size_t)index & ~(HashMapControl::GROUP_WIDTH - 1);
+    if (HashMapControl::groupMatch(map.control + groupStart, HashMapControl::EMPTY))
+    {
+        map.control[index] = HashMapControl::EMPTY;
+    }
+    else
+    {
+        map.control[index] = HashMapControl::DELETED;
+        map.tombstones++;
+    }
+
+    map.entries[index] = {};
     map.size--;
+
+    return true;
 }
 
 TRIVIAL_TEMPLATE_KV(K, V)
 void mapClear(HashMap<K, V>& map)
 {
-    if (map.entries)
-        memset(map.entries, 0, map.capacity * sizeof(HashMap<K, V>::Entry));
+    if (map.control)
+        memset(map.control, (uint8_t)HashMapControl::EMPTY, map.capacity);
     map.size = 0;
+    map.tombstones = 0;
 }
 
 TRIVIAL_TEMPLATE_KV(K, V)
 void mapFree(HashMap<K, V>& map)
 {
-    if (!map.entries)
+    if (!map.control)
         return;
 
-    free(map.entries);
+    if (!map.arena)
+        std::free(map.control);
+
+    map.control = nullptr;
     map.entries = nullptr;
     map.size = 0;
     map.capacity = 0;
+    map.tombstones = 0;
 }
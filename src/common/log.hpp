@@ -1,14 +1,29 @@
 #pragma once
 
+#include <cassert>
 #include <cstdio>
 #include <ctime>
+#include <cwchar>
 
 #include "utils.hpp"
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <Windows.h>
 #include <windowsx.h>
+#else
+// tests and tools built off windows log to stderr
+inline void OutputDebugStringA(const char* message)
+{
+    fputs(message, stderr);
+}
+
+inline void OutputDebugStringW(const wchar_t* message)
+{
+    fputws(message, stderr);
+}
+#endif
 
 inline const char* g_logFile = nullptr;
 inline int g_logLine = 0;
@@ -24,12 +39,12 @@ DEFINE_ENUM_BITWISE_OPERATORS(LogFlag)
 
 inline LogFlag g_logFlags = LogFlag::Verbose;
 
-#define logInfo(msg, ...)        \
-    do                           \
-    {                            \
-        g_logFile = __FILE__;    \
-        g_logLine = __LINE__;    \
-        g_log(msg, __VA_ARGS__); \
+#define logInfo(msg, ...)          \
+    do                             \
+    {                              \
+        g_logFile = __FILE__;      \
+        g_logLine = __LINE__;      \
+        g_log(msg, ##__VA_ARGS__); \
     } while (0)
 
 #define logInfoW(msg, ...)                \
@@ -38,7 +53,7 @@ inline LogFlag g_logFlags = LogFlag::Verbose;
         g_logFile = __FILE__;             \
         g_logLine = __LINE__;             \
         g_logFlags |= LogFlag::WideChar;  \
-        g_logW(msg, __VA_ARGS__);         \
+        g_logW(msg, ##__VA_ARGS__);       \
         g_logFlags &= ~LogFlag::WideChar; \
     } while (0)
 
@@ -48,7 +63,7 @@ inline LogFlag g_logFlags = LogFlag::Verbose;
         g_logFile = __FILE__;          \
         g_logLine = __LINE__;          \
         g_logFlags |= LogFlag::Error;  \
-        g_log(msg, __VA_ARGS__);       \
+        g_log(msg, ##__VA_ARGS__);     \
         g_logFlags &= ~LogFlag::Error; \
     } while (0)
 
@@ -58,10 +73,27 @@ inline LogFlag g_logFlags = LogFlag::Verbose;
         g_logFile = __FILE__;                              \
         g_logLine = __LINE__;                              \
         g_logFlags |= LogFlag::WideChar | LogFlag::Error;  \
-        g_logW(msg, __VA_ARGS__);                          \
+        g_logW(msg, ##__VA_ARGS__);                        \
         g_logFlags &= ~LogFlag::WideChar | LogFlag::Error; \
     } while (0)
 
+#define LOGIC_ERROR()             \
+    do                            \
+    {                             \
+        logError("logic error!"); \
+        assert(false);            \
+    } while (0)
+
+#define ENSURE(x)                          \
+    do                                     \
+    {                                      \
+        if (!(x))                          \
+        {                                  \
+            logError("ensure failed:" #x); \
+            assert(false);                 \
+        }                                  \
+    } while (0)
+
 template <typename... Args>
 void g_log(const char* message, Args... args)
 {
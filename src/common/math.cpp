@@ -4,6 +4,16 @@
 
 #define NOMINMAX
 
+#if defined(__AVX__)
+#define MATH_SIMD_WIDTH 8
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_SIMD_WIDTH 4
+#include <xmmintrin.h>
+#else
+#define MATH_SIMD_WIDTH 0
+#endif
+
 vec3 getForwardVector(mat4 rotation)
 {
     return {rotation[2][0], rotation[2][1], rotation[2][2]};
@@ -95,56 +105,273 @@ vec3 directionToEuler(vec3 direction, vec3 viewUp)
     return quatToEuler(quatLookAt(direction, viewUp));
 }
 
-vec3 matrixExtractPosition(mat4 mat)
+// T * R * S written out directly: the rotation matrix of a unit quaternion with each column scaled by its axis
+static void s_transformToAffine(vec3 position, quat rotation, vec3 scale, Affine& out)
+{
+    const auto x2 = rotation.x + rotation.x;
+    const auto y2 = rotation.y + rotation.y;
+    const auto z2 = rotation.z + rotation.z;
+    const auto xx = rotation.x * x2, yy = rotation.y * y2, zz = rotation.z * z2;
+    const auto xy = rotation.x * y2, xz = rotation.x * z2, yz = rotation.y * z2;
+    const auto wx = rotation.w * x2, wy = rotation.w * y2, wz = rotation.w * z2;
+
+    out.rows[0] = vec4((1.f - (yy + zz)) * scale.x, (xy - wz) * scale.y, (xz + wy) * scale.z, position.x);
+    out.rows[1] = vec4((xy + wz) * scale.x, (1.f - (xx + zz)) * scale.y, (yz - wx) * scale.z, position.y);
+    out.rows[2] = vec4((xz - wy) * scale.x, (yz + wx) * scale.y, (1.f - (xx + yy)) * scale.z, position.z);
+}
+
+Affine transformToAffine(vec3 position, quat rotation, vec3 scale)
+{
+    Affine result;
+    s_transformToAffine(position, rotation, scale, result);
+    return result;
+}
+
+#if MATH_SIMD_WIDTH
+// one lane per entity, the same closed form as s_transformToAffine
+#if MATH_SIMD_WIDTH == 8
+using MathBlock = __m256;
+static MathBlock s_blockSplat(float value) { return _mm256_set1_ps(value); }
+static MathBlock s_blockAdd(MathBlock a, MathBlock b) { return _mm256_add_ps(a, b); }
+static MathBlock s_blockSub(MathBlock a, MathBlock b) { return _mm256_sub_ps(a, b); }
+static MathBlock s_blockMul(MathBlock a, MathBlock b) { return _mm256_mul_ps(a, b); }
+#else
+using MathBlock = __m128;
+static MathBlock s_blockSplat(float value) { return _mm_set1_ps(value); }
+static MathBlock s_blockAdd(MathBlock a, MathBlock b) { return _mm_add_ps(a, b); }
+static MathBlock s_blockSub(MathBlock a, MathBlock b) { return _mm_sub_ps(a, b); }
+static MathBlock s_blockMul(MathBlock a, MathBlock b) { return _mm_mul_ps(a, b); }
+#endif
+
+// lane i gets values[i * stride], turns an array of vec3 or quat into one block per component.
+// set instead of loading from a stack array, which stalls on store forwarding
+static MathBlock s_blockGather(const float* values, size_t stride)
 {
-    return {mat[3][0], mat[3][1], mat[3][2]};
+#if MATH_SIMD_WIDTH == 8
+    return _mm256_setr_ps(values[0], values[stride], values[2 * stride], values[3 * stride], values[4 * stride],
+        values[5 * stride], values[6 * stride], values[7 * stride]);
+#else
+    return _mm_setr_ps(values[0], values[stride], values[2 * stride], values[3 * stride]);
+#endif
+}
+
+// the blocks hold the four columns of one row for every lane, transposed so each lane's row is stored in one go
+static void s_blockStoreRow(Affine* out, int row, MathBlock column0, MathBlock column1, MathBlock column2, MathBlock column3)
+{
+#if MATH_SIMD_WIDTH == 8
+    // the 256-bit unpacks and shuffles work per 128-bit half, the low half ends up with lanes 0-3, the high one with 4-7
+    const auto t0 = _mm256_unpacklo_ps(column0, column1);
+    const auto t1 = _mm256_unpacklo_ps(column2, column3);
+    const auto t2 = _mm256_unpackhi_ps(column0, column1);
+    const auto t3 = _mm256_unpackhi_ps(column2, column3);
+    const __m256 rows[4] = {
+        _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)),
+        _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)),
+        _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+        _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+    };
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        _mm_storeu_ps(&out[lane].rows[row].x, _mm256_castps256_ps128(rows[lane]));
+        _mm_storeu_ps(&out[lane + 4].rows[row].x, _mm256_extractf128_ps(rows[lane], 1));
+    }
+#else
+    _MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+    _mm_storeu_ps(&out[0].rows[row].x, column0);
+    _mm_storeu_ps(&out[1].rows[row].x, column1);
+    _mm_storeu_ps(&out[2].rows[row].x, column2);
+    _mm_storeu_ps(&out[3].rows[row].x, column3);
+#endif
 }
 
-vec3 matrixExtractScale(mat4 mat)
+static void s_transformsToAffinesBlock(vec3 const* positions, quat const* rotations, vec3 const* scales, Affine* out)
 {
-    vec3 scale{};
-    scale.x = glm::length(mat[0]);
-    scale.y = glm::length(mat[1]);
-    scale.z = glm::length(mat[2]);
-    return scale;
+    constexpr auto vec3Stride = sizeof(vec3) / sizeof(float);
+    constexpr auto quatStride = sizeof(quat) / sizeof(float);
+
+    const auto qx = s_blockGather(&rotations->x, quatStride);
+    const auto qy = s_blockGather(&rotations->y, quatStride);
+    const auto qz = s_blockGather(&rotations->z, quatStride);
+    const auto qw = s_blockGather(&rotations->w, quatStride);
+
+    const auto x2 = s_blockAdd(qx, qx);
+    const auto y2 = s_blockAdd(qy, qy);
+    const auto z2 = s_blockAdd(qz, qz);
+    const auto xx = s_blockMul(qx, x2), yy = s_blockMul(qy, y2), zz = s_blockMul(qz, z2);
+    const auto xy = s_blockMul(qx, y2), xz = s_blockMul(qx, z2), yz = s_blockMul(qy, z2);
+    const auto wx = s_blockMul(qw, x2), wy = s_blockMul(qw, y2), wz = s_blockMul(qw, z2);
+
+    const auto one = s_blockSplat(1.f);
+    const auto sx = s_blockGather(&scales->x, vec3Stride);
+    const auto sy = s_blockGather(&scales->y, vec3Stride);
+    const auto sz = s_blockGather(&scales->z, vec3Stride);
+
+    s_blockStoreRow(out, 0,
+        s_blockMul(s_blockSub(one, s_blockAdd(yy, zz)), sx),
+        s_blockMul(s_blockSub(xy, wz), sy),
+        s_blockMul(s_blockAdd(xz, wy), sz),
+        s_blockGather(&positions->x, vec3Stride));
+
+    s_blockStoreRow(out, 1,
+        s_blockMul(s_blockAdd(xy, wz), sx),
+        s_blockMul(s_blockSub(one, s_blockAdd(xx, zz)), sy),
+        s_blockMul(s_blockSub(yz, wx), sz),
+        s_blockGather(&positions->y, vec3Stride));
+
+    s_blockStoreRow(out, 2,
+        s_blockMul(s_blockSub(xz, wy), sx),
+        s_blockMul(s_blockAdd(yz, wx), sy),
+        s_blockMul(s_blockSub(one, s_blockAdd(xx, yy)), sz),
+        s_blockGather(&positions->z, vec3Stride));
 }
+#endif
 
-mat4 transformToMatrix(vec3 position, quat rotation, vec3 _scale)
+void transformsToAffines(vec3 const* positions, quat const* rotations, vec3 const* scales, Affine* out, size_t count)
 {
-    const auto scaleMatrix = scale(mat4(1.f), _scale);
-    const auto rotMatrix = toMat4(rotation);
-    const auto posMatrix = translate(mat4(1.f), position);
-    return posMatrix * rotMatrix * scaleMatrix;
+    size_t i = 0;
+#if MATH_SIMD_WIDTH
+    for (; i + MATH_SIMD_WIDTH <= count; i += MATH_SIMD_WIDTH)
+        s_transformsToAffinesBlock(positions + i, rotations + i, scales + i, out + i);
+#endif
+    for (; i < count; ++i)
+        s_transformToAffine(positions[i], rotations[i], scales[i], out[i]);
 }
 
-void matrixExtractRotation(mat4 mat, vec3 scale, quat& outRot, vec3& outEuler)
+static quat s_linearExtractRotation(mat3 linear, vec3 scale)
 {
-    auto rotationMatrix = mat;
-    // removing translation (glm stores matrices in column-major order!)
-    rotationMatrix[3][0] = 0;
-    rotationMatrix[3][1] = 0;
-    rotationMatrix[3][2] = 0;
-    vec3 absScale = glm::abs(scale);
     const float epsilon = 0.0001f;
-    // removing scale which is in 3x3 cells
-    if (absScale.x > epsilon)
-        rotationMatrix[0] /= vec4{scale, 1.f};
-    if (absScale.y > epsilon)
-        rotationMatrix[1] /= vec4{scale, 1.f};
-    if (absScale.z > epsilon)
-        rotationMatrix[2] /= vec4{scale, 1.f};
-    outRot = toQuat(rotationMatrix);
-    outEuler = quatToEuler(outRot);
+    // removing scale, each column is scaled by its own axis
+    for (int axis = 0; axis < 3; ++axis)
+        if (std::abs(scale[axis]) > epsilon)
+            linear[axis] /= scale[axis];
+    return toQuat(linear);
+}
+
+// (T * R * S)^-1 = S^-1 * R^T * T^-1, no general inverse needed when the parts are known
+Affine transformToInverseAffine(vec3 position, quat rotation, vec3 scale)
+{
+    // the rows of S^-1 * R^T are the columns of R divided by their axis scale
+    const auto rotationMatrix = toMat3(rotation);
+    Affine result;
+    for (int row = 0; row < 3; ++row)
+    {
+        const auto axis = rotationMatrix[row] / scale[row];
+        result.rows[row] = vec4(axis, -dot(axis, position));
+    }
+    return result;
+}
+
+// the 3x3 part in glm's column-major layout
+static mat3 s_affineLinear(Affine const& affine)
+{
+    return transpose(mat3(vec3(affine.rows[0]), vec3(affine.rows[1]), vec3(affine.rows[2])));
+}
+
+Affine affineMultiply(Affine const& a, Affine const& b)
+{
+    Affine result;
+    for (int row = 0; row < 3; ++row)
+    {
+        const auto& r = a.rows[row];
+        result.rows[row] = r.x * b.rows[0] + r.y * b.rows[1] + r.z * b.rows[2] + vec4(0.f, 0.f, 0.f, r.w);
+    }
+    return result;
+}
+
+Affine affineInverse(Affine const& affine)
+{
+    // the columns of R * S are the rotated axes times their scale, so while they stay perpendicular the rows of
+    // the inverse are those columns over their squared length, the same S^-1 * R^T transformToInverseAffine builds
+    vec3 columns[3];
+    for (int column = 0; column < 3; ++column)
+        columns[column] = vec3(affine.rows[0][column], affine.rows[1][column], affine.rows[2][column]);
+    const vec3 lengths2(dot(columns[0], columns[0]), dot(columns[1], columns[1]), dot(columns[2], columns[2]));
+    const auto perpendicular = [&](int a, int b) {
+        const float cosine2Epsilon = 1e-10f;
+        const auto d = dot(columns[a], columns[b]);
+        return d * d <= cosine2Epsilon * lengths2[a] * lengths2[b];
+    };
+    if (perpendicular(0, 1) && perpendicular(0, 2) && perpendicular(1, 2))
+    {
+        const auto position = affineExtractPosition(affine);
+        Affine result;
+        for (int row = 0; row < 3; ++row)
+        {
+            const auto axis = columns[row] / lengths2[row];
+            result.rows[row] = vec4(axis, -dot(axis, position));
+        }
+        return result;
+    }
+
+    // a non-uniformly scaled parent shears its rotated children, no S^-1 * R^T undoes that
+    const auto linear = inverse(s_affineLinear(affine));
+    const auto translation = -(linear * affineExtractPosition(affine));
+    const auto rows = transpose(linear);
+    return {{vec4(rows[0], translation.x), vec4(rows[1], translation.y), vec4(rows[2], translation.z)}};
+}
+
+void transformsToClipMatrices(mat4 const& viewProjection, Affine const* worlds, mat4* out, size_t count)
+{
+    // row r of viewProjection * world is row r of viewProjection times the world's rows, plus its w for the translation
+    const auto rows = transpose(viewProjection);
+#if MATH_SIMD_WIDTH
+    __m128 splats[4][4];
+    for (int row = 0; row < 4; ++row)
+        for (int column = 0; column < 4; ++column)
+            splats[row][column] = _mm_set1_ps(rows[row][column]);
+    const auto unitW = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto world0 = _mm_loadu_ps(&worlds[i].rows[0].x);
+        const auto world1 = _mm_loadu_ps(&worlds[i].rows[1].x);
+        const auto world2 = _mm_loadu_ps(&worlds[i].rows[2].x);
+        for (int row = 0; row < 4; ++row)
+        {
+            const auto xy = _mm_add_ps(_mm_mul_ps(splats[row][0], world0), _mm_mul_ps(splats[row][1], world1));
+            const auto zw = _mm_add_ps(_mm_mul_ps(splats[row][2], world2), _mm_mul_ps(splats[row][3], unitW));
+            _mm_storeu_ps(&out[i][row].x, _mm_add_ps(xy, zw));
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto& world = worlds[i];
+        for (int row = 0; row < 4; ++row)
+        {
+            const auto& r = rows[row];
+            out[i][row] = r.x * world.rows[0] + r.y * world.rows[1] + r.z * world.rows[2] + vec4(0.f, 0.f, 0.f, r.w);
+        }
+    }
+#endif
+}
+
+vec3 affineTransformPoint(Affine const& affine, vec3 point)
+{
+    const auto p = vec4(point, 1.f);
+    return {dot(affine.rows[0], p), dot(affine.rows[1], p), dot(affine.rows[2], p)};
+}
+
+vec3 affineExtractPosition(Affine const& affine)
+{
+    return {affine.rows[0].w, affine.rows[1].w, affine.rows[2].w};
+}
+
+vec3 affineExtractScale(Affine const& affine)
+{
+    const auto linear = s_affineLinear(affine);
+    return {glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])};
 }
 
-vec3 worldToLocal(vec3 worldPoint, mat4 parentMatrix)
+quat affineExtractRotation(Affine const& affine, vec3 scale)
 {
-    return glm::inverse(parentMatrix) * vec4(worldPoint, 1.f);
+    return s_linearExtractRotation(s_affineLinear(affine), scale);
 }
 
 quat worldToLocal(quat worldRot, quat parentWorldRot)
 {
-    return glm::inverse(parentWorldRot) * worldRot;
+    // rotations are unit quaternions, their inverse is the conjugate
+    return conjugate(parentWorldRot) * worldRot;
 }
 
 float remap(float source, float sourceFrom, float sourceTo, float targetFrom, float targetTo)
@@ -38,12 +38,26 @@ vec3 quatToDirection(quat const& quat, vec3 viewUp = vec3(0, 1, 0));
 quat directionToQuat(vec3 direction, vec3 viewUp = vec3(0, 1, 0));
 vec3 directionToEuler(vec3 direction, vec3 viewUp = vec3(0, 1, 0));
 
-vec3 matrixExtractPosition(mat4 mat);
-vec3 matrixExtractScale(mat4 mat);
-void matrixExtractRotation(mat4 mat, vec3 scale, quat& outRot, vec3& outEuler);
-mat4 transformToMatrix(vec3 translation, quat rotation, vec3 scale);
+// affine transform as the top three rows of a 4x4 matrix, the bottom row is always (0, 0, 0, 1).
+// stored by rows so it can be copied as is into a row_major float3x4 shader constant
+struct Affine
+{
+    vec4 rows[3];
+};
+
+Affine transformToAffine(vec3 translation, quat rotation, vec3 scale);
+Affine transformToInverseAffine(vec3 translation, quat rotation, vec3 scale);
+// out[i] = transformToAffine(positions[i], rotations[i], scales[i]), several entries at a time where SIMD is available
+void transformsToAffines(vec3 const* positions, quat const* rotations, vec3 const* scales, Affine* out, size_t count);
+Affine affineMultiply(Affine const& a, Affine const& b);
+// out[i] = transpose(viewProjection * worlds[i]), already in the row layout the shaders read
+void transformsToClipMatrices(mat4 const& viewProjection, Affine const* worlds, mat4* out, size_t count);
+Affine affineInverse(Affine const& affine);
+vec3 affineTransformPoint(Affine const& affine, vec3 point);
+vec3 affineExtractPosition(Affine const& affine);
+vec3 affineExtractScale(Affine const& affine);
+quat affineExtractRotation(Affine const& affine, vec3 scale);
 
-vec3 worldToLocal(vec3 worldPoint, mat4 parentMatrix);
 quat worldToLocal(quat worldRot, quat parentWorldRot);
 
 template <typename T>
@@ -7,6 +7,30 @@ void arenaInit(Arena& arena, size_t sizeBytes, void* startAddr)
     arena.size = sizeBytes;
     arena.used = 0;
     arena.prevUsed = 0;
+    arena.committed = sizeBytes;
+    arena.commitGranularity = sizeBytes;
+    arena.decommitOnClear = false;
+    arena.commit = nullptr;
+    arena.decommit = nullptr;
+}
+
+void arenaInitGrowable(Arena& arena, size_t reserveBytes, bool decommitOnClear, void* startAddr)
+{
+    const auto pageSize = Platform::getPageSize();
+    ENSURE(pageSize != 0 && !(pageSize & (pageSize - 1)));
+
+    arena.commitGranularity = arenaAlignUp(ARENA_COMMIT_GRANULARITY, pageSize);
+    arena.size = arenaAlignUp(reserveBytes, arena.commitGranularity);
+    arena.buffer = (u8*)Platform::reserveMemory(arena.size, startAddr);
+    ENSURE(arena.buffer);
+    arena.used = 0;
+    arena.prevUsed = 0;
+    arena.committed = 0;
+    arena.decommitOnClear = decommitOnClear;
+    arena.commit = Platform::commitMemory;
+    arena.decommit = Platform::decommitMemory;
+
+    arenaCommit(arena, arena.commitGranularity);
 }
 
 void arenaDeinit(Arena& arena)
@@ -18,4 +42,7 @@ void arenaDeinit(Arena& arena)
     arena.size = 0;
     arena.used = 0;
     arena.prevUsed = 0;
+    arena.committed = 0;
+    arena.commit = nullptr;
+    arena.decommit = nullptr;
 }
@@ -2,20 +2,60 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
+#include "log.hpp"
+
+using ArenaCommitFunc = bool (*)(void* addr, size_t size);
+using ArenaDecommitFunc = void (*)(void* addr, size_t size);
+
+static constexpr size_t ARENA_COMMIT_GRANULARITY = 64 * 1024;
+
 struct Arena
 {
     uint8_t* buffer;
-    size_t size;
+    size_t size;  // reserved address space
     size_t used;
     size_t prevUsed;
+
+    // growable arenas only reserve `size` up front and commit pages as `used` crosses `committed`.
+    // the platform functions are stored here because the game dll can't call into the platform layer
+    size_t committed;
+    size_t commitGranularity;
+    bool decommitOnClear;
+    ArenaCommitFunc commit;
+    ArenaDecommitFunc decommit;
 };
 
 // calling platform to allocate and free, only compiled in main exe
 void arenaInit(Arena& arena, size_t sizeBytes, void* startAddr = nullptr);
+void arenaInitGrowable(Arena& arena, size_t reserveBytes, bool decommitOnClear = false, void* startAddr = nullptr);
 void arenaDeinit(Arena& arena);
 
+inline size_t arenaAlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline void arenaCommit(Arena& arena, size_t requiredBytes)
+{
+    assert(arena.commit != nullptr);
+    assert(requiredBytes <= arena.size);
+
+    auto newCommitted = arenaAlignUp(requiredBytes, arena.commitGranularity);
+    newCommitted = newCommitted > arena.size ? arena.size : newCommitted;
+
+    // nothing hands back a failed allocation, so running out of memory ends here rather than at the first write
+    if (!arena.commit(arena.buffer + arena.committed, newCommitted - arena.committed))
+    {
+        logError("failed to commit %zu bytes of arena memory", newCommitted - arena.committed);
+        abort();
+    }
+
+    arena.committed = newCommitted;
+}
+
 inline void* arenaAlloc(Arena& arena, size_t allocSize, size_t allocAlign)
 {
     const auto alignmentIsPowerOfTwo = !(allocAlign & (allocAlign - 1));
@@ -27,6 +67,9 @@ inline void* arenaAlloc(Arena& arena, size_t allocSize, size_t allocAlign)
     const auto padding = remainder ? (allocAlign - remainder) : 0;
     assert(arena.used + allocSize + padding <= arena.size);
 
+    if (arena.used + allocSize + padding > arena.committed)
+        arenaCommit(arena, arena.used + allocSize + padding);
+
     const auto ptr = arena.buffer + arena.used + padding;
 
     // logInfo("arena allocated %.3f mb / %.2f kb / %llu bytes (padding: %llu), from 0x%llx to 0x%llx",
@@ -65,4 +108,56 @@ inline void arenaClear(Arena& arena)
 {
     arena.used = 0;
     arena.prevUsed = 0;
+
+    // keeping the first granule committed, it is going to be touched again right away
+    if (arena.decommitOnClear && arena.decommit && arena.committed > arena.commitGranularity)
+    {
+        arena.decommit(arena.buffer + arena.commitGranularity, arena.committed - arena.commitGranularity);
+        arena.committed = arena.commitGranularity;
+    }
+}
+
+// marker for rewinding an arena, scopes can nest but must be ended in reverse order
+struct ArenaTemp
+{
+    Arena* arena;
+    size_t used;
+    size_t prevUsed;
+};
+
+inline ArenaTemp arenaTempBegin(Arena& arena)
+{
+    return {.arena = &arena, .used = arena.used, .prevUsed = arena.prevUsed};
+}
+
+inline void arenaTempEnd(ArenaTemp temp)
+{
+    assert(temp.arena != nullptr);
+    assert(temp.used <= temp.arena->used);
+    temp.arena->used = temp.used;
+    temp.arena->prevUsed = temp.prevUsed;
+}
+
+// scratch arenas are registered per thread (and per module, since the game dll has its own thread_local copy)
+static constexpr auto SCRATCH_ARENA_COUNT = 2;
+inline thread_local Arena* g_scratchArenas[SCRATCH_ARENA_COUNT];
+
+inline void arenaScratchInit(Arena& first, Arena& second)
+{
+    g_scratchArenas[0] = &first;
+    g_scratchArenas[1] = &second;
+}
+
+// returns a scope on a scratch arena that is not `conflict`, so callers can allocate
+// intermediates while writing results into the arena they were given
+inline ArenaTemp arenaScratchBegin(Arena const* conflict = nullptr)
+{
+    for (auto scratch : g_scratchArenas)
+    {
+        if (scratch && scratch != conflict)
+            return arenaTempBegin(*scratch);
+    }
+
+    assert(false && "no scratch arena registered for this thread");
+    return {};
 }
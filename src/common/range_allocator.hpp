@@ -0,0 +1,113 @@
+#pragma once
+
+#include "utils.hpp"
+#include "memory.hpp"
+
+// first fit sub-allocation of a range of elements, like vertices of a shared gpu buffer. only the bookkeeping
+// lives here, free ranges are kept sorted by offset and merged with their neighbours when they are freed
+struct Range
+{
+    u32 offset;
+    u32 size;
+};
+
+static constexpr u32 RANGE_ALLOC_FAILED = ~0u;
+
+struct RangeAllocator
+{
+    Range* freeRanges;
+    u32 freeCount;
+    u32 freeCapacity;
+    u32 size;
+    u32 used;
+};
+
+inline void rangeAllocatorInit(RangeAllocator& allocator, u32 size, u32 maxFreeRanges, Arena& arena)
+{
+    allocator.freeRanges = arenaAlloc<Range>(arena, maxFreeRanges);
+    allocator.freeRanges[0] = {.offset = 0, .size = size};
+    allocator.freeCount = 1;
+    allocator.freeCapacity = maxFreeRanges;
+    allocator.size = size;
+    allocator.used = 0;
+}
+
+// offset is RANGE_ALLOC_FAILED when no free range is large enough
+inline Range rangeAlloc(RangeAllocator& allocator, u32 size)
+{
+    if (size == 0)
+        return {.offset = 0, .size = 0};
+
+    for (u32 i = 0; i < allocator.freeCount; ++i)
+    {
+        auto& freeRange = allocator.freeRanges[i];
+        if (freeRange.size < size)
+            continue;
+
+        const Range result = {.offset = freeRange.offset, .size = size};
+        freeRange.offset += size;
+        freeRange.size -= size;
+        if (freeRange.size == 0)
+        {
+            memmove(&allocator.freeRanges[i], &allocator.freeRanges[i + 1], (allocator.freeCount - i - 1) * sizeof(Range));
+            allocator.freeCount--;
+        }
+        allocator.used += size;
+        return result;
+    }
+
+    return {.offset = RANGE_ALLOC_FAILED, .size = 0};
+}
+
+// false when the range can't be merged and the free list is full, the range then stays allocated for good
+inline bool rangeFree(RangeAllocator& allocator, Range range)
+{
+    if (range.size == 0)
+        return true;
+    assert(range.offset + range.size <= allocator.size);
+
+    // first free range after the freed one
+    u32 low = 0, high = allocator.freeCount;
+    while (low < high)
+    {
+        const auto middle = (low + high) / 2;
+        if (allocator.freeRanges[middle].offset < range.offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    const auto next = low;
+
+    auto ranges = allocator.freeRanges;
+    const auto mergesPrev = next > 0 && ranges[next - 1].offset + ranges[next - 1].size == range.offset;
+    const auto mergesNext = next < allocator.freeCount && range.offset + range.size == ranges[next].offset;
+    assert(next == 0 || ranges[next - 1].offset + ranges[next - 1].size <= range.offset);
+    assert(next == allocator.freeCount || range.offset + range.size <= ranges[next].offset);
+
+    if (mergesPrev && mergesNext)
+    {
+        ranges[next - 1].size += range.size + ranges[next].size;
+        memmove(&ranges[next], &ranges[next + 1], (allocator.freeCount - next - 1) * sizeof(Range));
+        allocator.freeCount--;
+    }
+    else if (mergesPrev)
+    {
+        ranges[next - 1].size += range.size;
+    }
+    else if (mergesNext)
+    {
+        ranges[next].offset = range.offset;
+        ranges[next].size += range.size;
+    }
+    else
+    {
+        if (allocator.freeCount == allocator.freeCapacity)
+            return false;
+        memmove(&ranges[next + 1], &ranges[next], (allocator.freeCount - next) * sizeof(Range));
+        ranges[next] = range;
+        allocator.freeCount++;
+    }
+
+    allocator.used -= range.size;
+    return true;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "array.hpp"
+#include "utils.hpp"
+
+// 32-bit generational handle: low bits are the slot index, high bits the generation of that slot.
+// generation 0 is never handed out, so a zeroed handle is always invalid
+template <typename T>
+struct Handle
+{
+    u32 value;
+
+    operator bool() const { return value != 0; }
+    bool operator==(Handle const& other) const { return value == other.value; }
+    bool operator!=(Handle const& other) const { return value != other.value; }
+};
+
+static constexpr u32 HANDLE_INDEX_BITS = 20;
+static constexpr u32 HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+static constexpr u32 HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+static constexpr u32 SLOT_MAP_MAX_CAPACITY = HANDLE_INDEX_MASK;
+static constexpr u32 SLOT_MAP_INVALID_INDEX = ~0u;
+
+template <typename T>
+u32 handleIndex(Handle<T> handle)
+{
+    return handle.value & HANDLE_INDEX_MASK;
+}
+
+template <typename T>
+u32 handleGeneration(Handle<T> handle)
+{
+    return handle.value >> HANDLE_INDEX_BITS;
+}
+
+template <typename T>
+Handle<T> makeHandle(u32 index, u32 generation)
+{
+    return {.value = (generation << HANDLE_INDEX_BITS) | (index & HANDLE_INDEX_MASK)};
+}
+
+// values are kept densely packed for iteration, slots map handles to dense indices.
+// erasing swaps the last value into the hole, so pointers to values are only stable until the next erase.
+// freed slots are reused oldest first, so a slot's generation only advances once per trip through the free list,
+// and a slot whose generation runs out is retired rather than wrapped back to a value old handles may hold
+TRIVIAL_TEMPLATE_T(T)
+struct SlotMap
+{
+    struct Slot
+    {
+        u32 denseIndex;  // next free slot while the slot is unused
+        u32 generation;
+    };
+
+    T* dense;
+    u32* denseToSlot;
+    Slot* slots;
+    size_t size;
+    size_t capacity;
+    u32 slotsUsed;
+    u32 freeHead;
+    u32 freeTail;
+
+    T* begin() { return dense; }
+    T* end() { return dense + size; }
+    const T* begin() const { return dense; }
+    const T* end() const { return dense + size; }
+
+    T& operator[](size_t denseIndex) { return dense[denseIndex]; }
+    const T& operator[](size_t denseIndex) const { return dense[denseIndex]; }
+};
+
+TRIVIAL_TEMPLATE_T(T)
+void slotMapInit(SlotMap<T>& map, size_t capacity, Arena& arena, const char* tag = "slot map")
+{
+    assert(capacity <= SLOT_MAP_MAX_CAPACITY);
+    map.dense = arenaAlloc<T>(arena, capacity);
+    map.denseToSlot = arenaAlloc<u32>(arena, capacity);
+    map.slots = arenaAlloc<typename SlotMap<T>::Slot>(arena, capacity);
+    map.size = 0;
+    map.capacity = capacity;
+    map.slotsUsed = 0;
+    map.freeHead = SLOT_MAP_INVALID_INDEX;
+    map.freeTail = SLOT_MAP_INVALID_INDEX;
+    logInfo("SLOT_MAP_INIT: %s at 0x%llx", tag, map.dense);
+}
+
+TRIVIAL_TEMPLATE_T(T)
+Handle<T> slotMapInsert(SlotMap<T>& map, T value)
+{
+    assert(map.size < map.capacity);
+
+    u32 slotIndex;
+    if (map.freeHead != SLOT_MAP_INVALID_INDEX)
+    {
+        slotIndex = map.freeHead;
+        map.freeHead = map.slots[slotIndex].denseIndex;
+        if (map.freeHead == SLOT_MAP_INVALID_INDEX)
+            map.freeTail = SLOT_MAP_INVALID_INDEX;
+    }
+    else
+    {
+        // only fails once retired slots have used up the capacity
+        ENSURE(map.slotsUsed < map.capacity);
+        slotIndex = map.slotsUsed++;
+        map.slots[slotIndex].generation = 1;
+    }
+
+    auto& slot = map.slots[slotIndex];
+    slot.denseIndex = (u32)map.size;
+    map.dense[map.size] = value;
+    map.denseToSlot[map.size] = slotIndex;
+    map.size++;
+
+    return makeHandle<T>(slotIndex, slot.generation);
+}
+
+TRIVIAL_TEMPLATE_T(T)
+T* slotMapGet(SlotMap<T>& map, Handle<T> handle)
+{
+    const auto slotIndex = handleIndex(handle);
+    if (!handle || slotIndex >= map.slotsUsed)
+        return nullptr;
+
+    const auto& slot = map.slots[slotIndex];
+    if (slot.generation == 0 || slot.generation != handleGeneration(handle))
+        return nullptr;
+
+    return &map.dense[slot.denseIndex];
+}
+
+TRIVIAL_TEMPLATE_T(T)
+bool slotMapContains(SlotMap<T>& map, Handle<T> handle)
+{
+    return slotMapGet(map, handle) != nullptr;
+}
+
+TRIVIAL_TEMPLATE_T(T)
+Handle<T> slotMapHandleAt(SlotMap<T>& map, size_t denseIndex)
+{
+    assert(denseIndex < map.size);
+    const auto slotIndex = map.denseToSlot[denseIndex];
+    return makeHandle<T>(slotIndex, map.slots[slotIndex].generation);
+}
+
+TRIVIAL_TEMPLATE_T(T)
+bool slotMapErase(SlotMap<T>& map, Handle<T> handle)
+{
+    if (!slotMapGet(map, handle))
+        return false;
+
+    const auto slotIndex = handleIndex(handle);
+    auto& slot = map.slots[slotIndex];
+
+    // moving the last value into the hole to keep the dense array packed
+    const auto lastIndex = (u32)map.size - 1;
+    if (slot.denseIndex != lastIndex)
+    {
+        map.dense[slot.denseIndex] = map.dense[lastIndex];
+        map.denseToSlot[slot.denseIndex] = map.denseToSlot[lastIndex];
+        map.slots[map.denseToSlot[slot.denseIndex]].denseIndex = slot.denseIndex;
+    }
+    map.dense[lastIndex] = T{};
+    map.size--;
+
+    // bumping the generation invalidates every outstanding handle to this slot
+    if (slot.generation == HANDLE_GENERATION_MASK)
+    {
+        // generation 0 is never handed out, nothing resolves to a retired slot again
+        slot.generation = 0;
+        slot.denseIndex = SLOT_MAP_INVALID_INDEX;
+        return true;
+    }
+    slot.generation++;
+
+    slot.denseIndex = SLOT_MAP_INVALID_INDEX;
+    if (map.freeTail != SLOT_MAP_INVALID_INDEX)
+        map.slots[map.freeTail].denseIndex = slotIndex;
+    else
+        map.freeHead = slotIndex;
+    map.freeTail = slotIndex;
+
+    return true;
+}
+
+TRIVIAL_TEMPLATE_T(T)
+void slotMapClear(SlotMap<T>& map)
+{
+    for (size_t i = map.size; i > 0; --i)
+        slotMapErase(map, slotMapHandleAt(map, i - 1));
+}
@@ -1,139 +1,298 @@
 #include "string.hpp"
 #include "memory.hpp"
 
-static constexpr auto s_isEqual = [](char a, char b) { return a == b; };
-static constexpr auto s_isNotEqual = [](char a, char b) { return a != b; };
+#if defined(__AVX2__)
+#define STRING_SIMD_WIDTH 32
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STRING_SIMD_WIDTH 16
+#include <emmintrin.h>
+#else
+#define STRING_SIMD_WIDTH 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static constexpr ptrdiff_t STR_NOT_FOUND = -1;
+
+static u32 s_lowestBit(u32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctz(mask);
+#endif
+}
 
-static String s_strFind(
-    bool (*comparisonFunc)(char, char), String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
+static u32 s_highestBit(u32 mask)
 {
-    String result{};
-    if (haystack.length == 0 || haystack.data == nullptr || needle.length == 0 || needle.data == nullptr)
-        return result;
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (u32)index;
+#else
+    return 31u - (u32)__builtin_clz(mask);
+#endif
+}
 
-    if (haystack.length < needle.length)
-        return result;
+#if STRING_SIMD_WIDTH
+// one block of the widest vector available, the kernels below only deal in blocks and bitmasks of matching bytes
+static constexpr size_t STR_BLOCK_WIDTH = STRING_SIMD_WIDTH;
+
+#if STRING_SIMD_WIDTH == 32
+using StrBlock = __m256i;
+static StrBlock s_blockLoad(const char* p)
+{
+    return _mm256_loadu_si256((const __m256i*)p);
+}
+static StrBlock s_blockSplat(char c)
+{
+    return _mm256_set1_epi8(c);
+}
+static u32 s_blockEqual(StrBlock a, StrBlock b)
+{
+    return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+}
+static constexpr u32 STR_BLOCK_MASK = 0xFFFFFFFFu;
+#else
+using StrBlock = __m128i;
+static StrBlock s_blockLoad(const char* p)
+{
+    return _mm_loadu_si128((const __m128i*)p);
+}
+static StrBlock s_blockSplat(char c)
+{
+    return _mm_set1_epi8(c);
+}
+static u32 s_blockEqual(StrBlock a, StrBlock b)
+{
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+}
+static constexpr u32 STR_BLOCK_MASK = 0xFFFFu;
+#endif
+
+// bit i is set when byte i of the block is one of the set's chars
+static u32 s_blockMatchAny(StrBlock block, String set)
+{
+    u32 mask = 0;
+    for (size_t i = 0; i < set.length; ++i)
+        mask |= s_blockEqual(block, s_blockSplat(set[i]));
+    return mask;
+}
+#endif
+
+static bool s_isInSet(char c, String set)
+{
+    for (size_t i = 0; i < set.length; ++i)
+        if (set[i] == c)
+            return true;
+    return false;
+}
+
+static ptrdiff_t s_findByte(const char* data, size_t length, char c)
+{
+    size_t i = 0;
+#if STRING_SIMD_WIDTH
+    const auto splat = s_blockSplat(c);
+    for (; i + STR_BLOCK_WIDTH <= length; i += STR_BLOCK_WIDTH)
+    {
+        if (const auto mask = s_blockEqual(s_blockLoad(data + i), splat); mask)
+            return (ptrdiff_t)(i + s_lowestBit(mask));
+    }
+#endif
+    if (const auto found = (const char*)memchr(data + i, c, length - i); found)
+        return found - data;
+    return STR_NOT_FOUND;
+}
+
+static ptrdiff_t s_findByteReverse(const char* data, size_t length, char c)
+{
+    size_t end = length;
+#if STRING_SIMD_WIDTH
+    const auto splat = s_blockSplat(c);
+    for (; end >= STR_BLOCK_WIDTH; end -= STR_BLOCK_WIDTH)
+    {
+        if (const auto mask = s_blockEqual(s_blockLoad(data + end - STR_BLOCK_WIDTH), splat); mask)
+            return (ptrdiff_t)(end - STR_BLOCK_WIDTH + s_highestBit(mask));
+    }
+#endif
+    while (end > 0)
+    {
+        if (data[--end] == c)
+            return (ptrdiff_t)end;
+    }
+    return STR_NOT_FOUND;
+}
 
-    size_t haystackTempIdx = 0;
-    size_t needleFound = 0;
-    for (size_t haystackIdx = 0; haystackIdx < haystack.length; ++haystackIdx)
+// candidates are filtered by comparing the needle's first and last bytes against two shifted loads,
+// only positions where both match get a full compare
+static ptrdiff_t s_findSubstring(const char* data, size_t length, String needle)
+{
+    if (needle.length == 1)
+        return s_findByte(data, length, needle[0]);
+
+    const auto lastStart = length - needle.length;
+    size_t i = 0;
+#if STRING_SIMD_WIDTH
+    const auto first = s_blockSplat(needle[0]);
+    const auto last = s_blockSplat(needle[needle.length - 1]);
+    for (; i + STR_BLOCK_WIDTH <= lastStart + 1; i += STR_BLOCK_WIDTH)
     {
-        haystackTempIdx = haystackIdx;
-        for (size_t needleIdx = 0; needleIdx < needle.length && haystackTempIdx < haystack.length;)
+        auto mask = s_blockEqual(s_blockLoad(data + i), first) & s_blockEqual(s_blockLoad(data + i + needle.length - 1), last);
+        for (; mask; mask &= mask - 1)
         {
-            const auto haystackChar = haystack[haystackTempIdx];
-            if (haystackChar == '\0')
-            {
-                haystackIdx = haystack.length;
-            }
-            else
-            {
-                if (const auto needleCharFound = comparisonFunc(needle[needleIdx], haystackChar); needleCharFound)
-                {
-                    needleFound++;
-
-                    if (needleFound < needle.length)
-                    {
-                        haystackTempIdx++;
-                        needleIdx++;
-                    }
-                    else
-                    {
-                        haystackIdx = haystack.length;
-                        needleIdx = needle.length;
-                    }
-                }
-                else
-                {
-                    needleFound = 0;
-                    needleIdx = needle.length;
-                }
-            }
+            const auto candidate = i + s_lowestBit(mask);
+            if (memcmp(data + candidate + 1, needle.data + 1, needle.length - 2) == 0)
+                return (ptrdiff_t)candidate;
         }
     }
+#endif
+    for (; i <= lastStart; ++i)
+    {
+        if (data[i] == needle[0] && memcmp(data + i + 1, needle.data + 1, needle.length - 1) == 0)
+            return (ptrdiff_t)i;
+    }
+    return STR_NOT_FOUND;
+}
 
-    if (needleFound != needle.length)
-        return result;
-
-    result.length = (returnOnlyOccurence ? needle.length : (haystack.length - haystackTempIdx)) - resultOffset;
-    result.data = haystack.data + haystackTempIdx + resultOffset;
-    return result;
+static ptrdiff_t s_findSubstringReverse(const char* data, size_t length, String needle)
+{
+    if (needle.length == 1)
+        return s_findByteReverse(data, length, needle[0]);
+
+    // candidate starts are [0, end)
+    size_t end = length - needle.length + 1;
+#if STRING_SIMD_WIDTH
+    const auto first = s_blockSplat(needle[0]);
+    const auto last = s_blockSplat(needle[needle.length - 1]);
+    for (; end >= STR_BLOCK_WIDTH; end -= STR_BLOCK_WIDTH)
+    {
+        const auto start = end - STR_BLOCK_WIDTH;
+        auto mask =
+            s_blockEqual(s_blockLoad(data + start), first) & s_blockEqual(s_blockLoad(data + start + needle.length - 1), last);
+        while (mask)
+        {
+            const auto bit = s_highestBit(mask);
+            if (memcmp(data + start + bit + 1, needle.data + 1, needle.length - 2) == 0)
+                return (ptrdiff_t)(start + bit);
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+    while (end > 0)
+    {
+        const auto i = --end;
+        if (data[i] == needle[0] && memcmp(data + i + 1, needle.data + 1, needle.length - 1) == 0)
+            return (ptrdiff_t)i;
+    }
+    return STR_NOT_FOUND;
 }
 
-static String s_strFindReverse(
-    bool (*comparisonFunc)(char, char), String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
+static ptrdiff_t s_findFirstNotOf(const char* data, size_t length, String set)
 {
-    String result{};
-    if (haystack.length == 0 || haystack.data == nullptr || needle.length == 0 || needle.data == nullptr)
-        return result;
+    size_t i = 0;
+#if STRING_SIMD_WIDTH
+    for (; i + STR_BLOCK_WIDTH <= length; i += STR_BLOCK_WIDTH)
+    {
+        if (const auto mask = ~s_blockMatchAny(s_blockLoad(data + i), set) & STR_BLOCK_MASK; mask)
+            return (ptrdiff_t)(i + s_lowestBit(mask));
+    }
+#endif
+    for (; i < length; ++i)
+    {
+        if (!s_isInSet(data[i], set))
+            return (ptrdiff_t)i;
+    }
+    return STR_NOT_FOUND;
+}
 
-    if (haystack.length < needle.length)
-        return result;
+static ptrdiff_t s_findFirstOf(const char* data, size_t length, String set)
+{
+    size_t i = 0;
+#if STRING_SIMD_WIDTH
+    for (; i + STR_BLOCK_WIDTH <= length; i += STR_BLOCK_WIDTH)
+    {
+        if (const auto mask = s_blockMatchAny(s_blockLoad(data + i), set); mask)
+            return (ptrdiff_t)(i + s_lowestBit(mask));
+    }
+#endif
+    for (; i < length; ++i)
+    {
+        if (s_isInSet(data[i], set))
+            return (ptrdiff_t)i;
+    }
+    return STR_NOT_FOUND;
+}
 
-    ptrdiff_t haystackTempIdx = 0;
-    size_t needleFound = 0;
-    for (ptrdiff_t haystackIdx = haystack.length - 1; haystackIdx >= 0; --haystackIdx)
+static ptrdiff_t s_findLastNotOf(const char* data, size_t length, String set)
+{
+    size_t end = length;
+#if STRING_SIMD_WIDTH
+    for (; end >= STR_BLOCK_WIDTH; end -= STR_BLOCK_WIDTH)
     {
-        haystackTempIdx = haystackIdx;
-        for (ptrdiff_t needleIdx = needle.length - 1; needleIdx >= 0 && haystackTempIdx >= 0;)
-        {
-            const auto haystackChar = haystack[haystackTempIdx];
-            if (haystackChar == '\0')
-            {
-                haystackIdx = -1;
-            }
-            else
-            {
-                if (const auto needleCharFound = comparisonFunc(needle[needleIdx], haystackChar); needleCharFound)
-                {
-                    needleFound++;
-
-                    if (needleFound < needle.length)
-                    {
-                        haystackTempIdx--;
-                        needleIdx--;
-                    }
-                    else
-                    {
-                        haystackIdx = -1;
-                        needleIdx = -1;
-                    }
-                }
-                else
-                {
-                    needleFound = 0;
-                    needleIdx = -1;
-                }
-            }
-        }
+        if (const auto mask = ~s_blockMatchAny(s_blockLoad(data + end - STR_BLOCK_WIDTH), set) & STR_BLOCK_MASK; mask)
+            return (ptrdiff_t)(end - STR_BLOCK_WIDTH + s_highestBit(mask));
     }
+#endif
+    while (end > 0)
+    {
+        if (!s_isInSet(data[--end], set))
+            return (ptrdiff_t)end;
+    }
+    return STR_NOT_FOUND;
+}
 
-    if (needleFound != needle.length)
+static String s_strFindResult(
+    String haystack, ptrdiff_t index, size_t occurenceLength, bool returnOnlyOccurence, ptrdiff_t resultOffset)
+{
+    String result{};
+    if (index == STR_NOT_FOUND)
         return result;
 
-    result.length = (returnOnlyOccurence ? needle.length : (haystack.length - haystackTempIdx)) - resultOffset;
-    result.data = haystack.data + haystackTempIdx + resultOffset;
+    result.length = (returnOnlyOccurence ? occurenceLength : (haystack.length - index)) - resultOffset;
+    result.data = haystack.data + index + resultOffset;
     return result;
 }
 
+static bool s_isSearchable(String haystack, String needle)
+{
+    return haystack && needle && haystack.length >= needle.length;
+}
+
 String strFind(String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
 {
-    return s_strFind(s_isEqual, haystack, needle, returnOnlyOccurence, resultOffset);
+    if (!s_isSearchable(haystack, needle))
+        return {};
+    const auto index = s_findSubstring(haystack.data, haystack.length, needle);
+    return s_strFindResult(haystack, index, needle.length, returnOnlyOccurence, resultOffset);
 }
 
 String strFindNot(String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
 {
-    return s_strFind(s_isNotEqual, haystack, needle, returnOnlyOccurence, resultOffset);
+    if (!s_isSearchable(haystack, needle))
+        return {};
+    const auto index = s_findFirstNotOf(haystack.data, haystack.length, needle);
+    return s_strFindResult(haystack, index, needle.length, returnOnlyOccurence, resultOffset);
 }
 
 String strFindReverse(String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
 {
-    return s_strFindReverse(s_isEqual, haystack, needle, returnOnlyOccurence, resultOffset);
+    if (!s_isSearchable(haystack, needle))
+        return {};
+    const auto index = s_findSubstringReverse(haystack.data, haystack.length, needle);
+    return s_strFindResult(haystack, index, needle.length, returnOnlyOccurence, resultOffset);
 }
 
 String strFindNotReverse(String haystack, String needle, bool returnOnlyOccurence, ptrdiff_t resultOffset)
 {
-    return s_strFindReverse(s_isNotEqual, haystack, needle, returnOnlyOccurence, resultOffset);
+    if (!s_isSearchable(haystack, needle))
+        return {};
+    const auto index = s_findLastNotOf(haystack.data, haystack.length, needle);
+    return s_strFindResult(haystack, index, needle.length, returnOnlyOccurence, resultOffset);
 }
 
 String strClone(const char* src, Arena& memory)
@@ -212,6 +371,59 @@ String strCopy(String const& src, char* dst, size_t dstLength)
     return result;
 }
 
+bool strNext(StrCursor& cursor, String& token)
+{
+    auto& rest = cursor.rest;
+    if (!rest)
+        return false;
+
+    const auto found = strFind(rest, cursor.delim);
+    if (!found)
+    {
+        token = rest;
+        rest = {.data = rest.data + rest.length, .length = 0};
+        return true;
+    }
+
+    const auto pieceLength = (size_t)(found.data - rest.data);
+    const auto consumed = pieceLength + cursor.delim.length;
+    token = {.data = rest.data, .length = cursor.delimInclusive ? consumed : pieceLength};
+    rest = {.data = rest.data + consumed, .length = rest.length - consumed};
+    return true;
+}
+
+bool strNextLine(StrCursor& cursor, String& line)
+{
+    if (!strNext(cursor, line))
+        return false;
+
+    if (line.length > 0 && line[line.length - 1] == '\r')
+        line.length--;
+    return true;
+}
+
+bool strNextField(StrFieldCursor& cursor, String& field)
+{
+    auto& rest = cursor.rest;
+    if (!rest)
+        return false;
+
+    const auto start = s_findFirstNotOf(rest.data, rest.length, cursor.delims);
+    if (start == STR_NOT_FOUND)
+    {
+        rest = {.data = rest.data + rest.length, .length = 0};
+        return false;
+    }
+
+    const auto remaining = rest.length - start;
+    const auto end = s_findFirstOf(rest.data + start, remaining, cursor.delims);
+    const auto fieldLength = end == STR_NOT_FOUND ? remaining : (size_t)end;
+
+    field = {.data = rest.data + start, .length = fieldLength};
+    rest = {.data = field.data + fieldLength, .length = remaining - fieldLength};
+    return true;
+}
+
 Array<String> strSplit(String src, String delim, Arena& memory, bool delimInclusive)
 {
     Array<String> result{};
@@ -220,31 +432,16 @@ Array<String> strSplit(String src, String delim, Arena& memory, bool delimInclus
         return result;
 
     size_t count = 0;
-    auto temp = src;
-    for (size_t charsRead = 0; charsRead < src.length;)
-    {
-        auto str = strFindUntil(temp, delim, delimInclusive);
-        if (!str)
-            break;
+    String token;
+    for (auto cursor = strCursor(src, delim, delimInclusive); strNext(cursor, token);)
         count++;
 
-        temp.data += str.length + (int)!delimInclusive;
-        charsRead += str.length + (int)!delimInclusive;
-    }
-
-    if (count == 0)
-        return result;
-
     result.data = arenaAlloc<String>(memory, count);
     result.size = count;
 
-    temp = src;
-    for (size_t i = 0; i < count; ++i)
-    {
-        auto str = strFindUntil(temp, delim, delimInclusive);
-        result[i] = strClone(str, memory);
-        temp.data += str.length + (int)!delimInclusive;
-    }
+    size_t i = 0;
+    for (auto cursor = strCursor(src, delim, delimInclusive); strNext(cursor, token);)
+        result[i++] = strClone(token, memory);
 
     return result;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "array.hpp"
+#include "hash.hpp"
 
 struct String
 {
@@ -42,6 +43,7 @@ inline bool operator==(String& str, const char* otherStr)
 }
 
 struct Arena;
+// strFind* return the first/last occurence of needle, strFindNot* the first/last char that isn't any of needle's chars
 String strFind(String haystack, String needle, bool returnOnlyOccurence = true, ptrdiff_t resultOffset = 0);
 String strFindNot(String haystack, String needle, bool returnOnlyOccurence = true, ptrdiff_t resultOffset = 0);
 String strFindReverse(String haystack, String needle, bool returnOnlyOccurence = true, ptrdiff_t resultOffset = 0);
@@ -54,6 +56,12 @@ String strAppend(String const& s1, String const& s2, Arena& memory);
 String strFindUntil(String src, String substr, bool inclusive = true);
 Array<String> strSplit(String src, String delim, Arena& memory, bool delimInclusive = false);
 
+// content hash, usable at compile time on literals: constexpr auto id = strHash(strL("name"));
+constexpr u64 strHash(String str)
+{
+    return hashBytes(str.data, str.length);
+}
+
 // from null term
 #define strSz(str)                                \
     String                                        \
@@ -65,3 +73,40 @@ Array<String> strSplit(String src, String delim, Arena& memory, bool delimInclus
 
 static constexpr auto STR_WHITESPACE = strL(" ");
 static constexpr auto STR_NEWL = strL("\n");
+static constexpr auto STR_BLANKS = strL(" \t\r");
+
+// lazy splitting over a view, tokens point into the source and nothing is copied.
+// pieces between two delimiters are returned even when empty, a trailing delimiter doesn't produce an empty piece
+struct StrCursor
+{
+    String rest;
+    String delim;
+    bool delimInclusive;
+};
+
+inline StrCursor strCursor(String src, String delim, bool delimInclusive = false)
+{
+    return {.rest = src, .delim = delim, .delimInclusive = delimInclusive};
+}
+
+inline StrCursor strLines(String src)
+{
+    return strCursor(src, STR_NEWL);
+}
+
+bool strNext(StrCursor& cursor, String& token);
+bool strNextLine(StrCursor& cursor, String& line);  // without the newline or a trailing \r
+
+// fields separated by runs of any of the delimiter chars, empty fields are skipped
+struct StrFieldCursor
+{
+    String rest;
+    String delims;
+};
+
+inline StrFieldCursor strFields(String src, String delims = STR_BLANKS)
+{
+    return {.rest = src, .delims = delims};
+}
+
+bool strNextField(StrFieldCursor& cursor, String& field);
@@ -25,6 +25,7 @@ privDefer<F> defer_func(F f)
     template <typename t>   \
         requires std::is_trivial_v<t>
 
+#include <cstddef>
 #include <cstdint>
 using u8 = std::uint8_t;
 using i8 = std::int8_t;
@@ -7,16 +7,25 @@ void contextInit(Context& context, size_t memorySize, size_t tempMemorySize)
     context.dt = 0.016f;
     context.render.needsToResize = true;
 
-    arenaInit(context.platformMemory, memorySize);
-    arenaInit(context.gameMemory, memorySize);
-    arenaInit(context.tempMemory, tempMemorySize);
+    // only reserving address space here, pages are committed as the arenas grow
+    arenaInitGrowable(context.platformMemory, memorySize);
+    arenaInitGrowable(context.gameMemory, memorySize, true);
+    arenaInitGrowable(context.tempMemory, tempMemorySize);
+    arenaInitGrowable(context.scratchMemory, tempMemorySize);
+    arenaScratchInit(context.tempMemory, context.scratchMemory);
 
     static constexpr auto MAX_ASSETS = 25;
 
-    arrayInit(context.render.drawCommands, 2000, context.gameMemory, "draw commands");
-    arrayInit(context.entityManager.entities, 3000, context.gameMemory, "entities");
+    slotMapInit(context.render.drawCommands, 2000, context.gameMemory, "draw commands");
+    renderAllocObjectVariables(context.render, context.gameMemory);
+    slotMapInit(context.entityManager.entities, 3000, context.gameMemory, "entities");
+    hierarchyInit(context.entityManager.hierarchy, context.entityManager.entities.capacity, context.gameMemory);
     arrayInit(context.render.meshes, MAX_ASSETS, context.gameMemory, "loaded meshes");
     arrayInit(context.render.allTextures, MAX_ASSETS, context.gameMemory, "loaded textures");
+    mapAlloc(context.render.meshIds, MAX_ASSETS, &context.gameMemory);
+    mapAlloc(context.render.textureIds, MAX_ASSETS, &context.gameMemory);
+    mapAlloc(context.render.cubemapIds, MAX_ASSETS, &context.gameMemory);
+    mapAlloc(context.render.pipelineStateIds, MAX_PIPELINE_STATES, &context.gameMemory);
     for (size_t i = 0; i < (i32)AssetType::Max; ++i)
         arrayInit(context.platform.assets[i], MAX_ASSETS, context.platformMemory, ASSETS_PATH[i]);
 }
@@ -25,23 +34,37 @@ void contextHotReload(Context& context)
 {
     arenaClear(context.gameMemory);
     arenaClear(context.tempMemory);
+    arenaClear(context.scratchMemory);
 
-    arrayInit(context.render.drawCommands, context.render.drawCommands.capacity, context.gameMemory, "draw commands");
-    arrayInit(context.entityManager.entities, context.entityManager.entities.capacity, context.gameMemory, "entities");
+    slotMapInit(context.render.drawCommands, context.render.drawCommands.capacity, context.gameMemory, "draw commands");
+    renderAllocObjectVariables(context.render, context.gameMemory);
+    slotMapInit(context.entityManager.entities, context.entityManager.entities.capacity, context.gameMemory, "entities");
+    hierarchyInit(context.entityManager.hierarchy, context.entityManager.hierarchy.capacity, context.gameMemory);
     arrayInit(context.render.meshes, context.render.meshes.capacity, context.gameMemory, "loaded meshes");
     arrayInit(context.render.allTextures, context.render.allTextures.capacity, context.gameMemory, "loaded textures");
+    mapAlloc(context.render.meshIds, context.render.meshIds.capacity, &context.gameMemory);
+    mapAlloc(context.render.textureIds, context.render.textureIds.capacity, &context.gameMemory);
+    mapAlloc(context.render.cubemapIds, context.render.cubemapIds.capacity, &context.gameMemory);
+    mapAlloc(context.render.pipelineStateIds, context.render.pipelineStateIds.capacity, &context.gameMemory);
+    context.render.pipelineStatesCount = 0;
+    context.render.boundState = {};
 }
 
 void contextDeinit(Context& context)
 {
-    arrayClear(context.entityManager.entities);
-    arrayClear(context.render.drawCommands);
+    slotMapClear(context.entityManager.entities);
+    slotMapClear(context.render.drawCommands);
     arrayClear(context.render.meshes);
     arrayClear(context.render.allTextures);
+    mapFree(context.render.meshIds);
+    mapFree(context.render.textureIds);
+    mapFree(context.render.cubemapIds);
+    mapFree(context.render.pipelineStateIds);
     for (size_t i = 0; i < (i32)AssetType::Max; ++i)
         arrayClear(context.platform.assets[i]);
 
     arenaDeinit(context.gameMemory);
     arenaDeinit(context.tempMemory);
+    arenaDeinit(context.scratchMemory);
     arenaDeinit(context.platformMemory);
 }
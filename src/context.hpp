@@ -11,7 +11,7 @@ struct CameraController
 {
     static constexpr auto PITCH_YAW_SMOOTHING = 30.f;
     static constexpr auto DEFAULT_SPEED = 1.f;
-    Entity* camera;
+    EntityHandle camera;
     bool isPressed;
     vec2 pressedPos;
     float speed;
@@ -23,10 +23,10 @@ struct CameraController
 
 struct GameState
 {
-    Entity* grid;
-    Entity* sphere;
+    EntityHandle grid;
+    EntityHandle sphere;
     CameraController cameraController;
-    Entity* light;
+    EntityHandle light;
 };
 
 struct Context
@@ -41,6 +41,7 @@ struct Context
     Arena platformMemory;  // lives the entire app
     Arena gameMemory;      // lives the entire app, cleared on hot-reload
     Arena tempMemory;      // lives for the duration of a frame
+    Arena scratchMemory;   // lives for the duration of a scratch scope
 
     PlatformToGameBuffer platform;
     InputState input;
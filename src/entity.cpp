@@ -1,72 +1,271 @@
 #include "entity.hpp"
 #include "context.hpp"
 
-static mat4 calculateWorldTransform(Entity& entity)
+Entity* getEntity(EntityHandle handle)
 {
-    if (!entity.isWorldMatrixDirty && !entity.parent)
-        return entity.worldMatrixCache;
+    ENSURE(g_context);
+    return slotMapGet(g_context->entityManager.entities, handle);
+}
+
+Entity& getCamera()
+{
+    const auto camera = getEntity(g_context->entityManager.camera);
+    ENSURE(camera);
+    return *camera;
+}
+
+DrawCommand* getDrawCommand(Entity const& entity)
+{
+    ENSURE(g_context);
+    return slotMapGet(g_context->render.drawCommands, entity.drawCommand);
+}
 
-    auto localMatrix = transformToMatrix(entity.position, entity.rotation, entity.scale);
+static TransformHierarchy& getHierarchy()
+{
+    ENSURE(g_context);
+    return g_context->entityManager.hierarchy;
+}
 
-    if (entity.parent)
+// drops entries of destroyed entities and reorders by depth, keeping the relative order within a depth
+static void hierarchySort(TransformHierarchy& hierarchy)
+{
+    const auto scratch = arenaScratchBegin();
+    defer({ arenaTempEnd(scratch); });
+    auto& memory = *scratch.arena;
+
+    const auto size = hierarchy.size;
+    auto depths = arenaAlloc<u32>(memory, size + 1);
+    u32 maxDepth = 0;
+    for (size_t i = 0; i < size; ++i)
     {
-        auto parentWorld = calculateWorldTransform(*entity.parent);
-        entity.worldMatrixCache = parentWorld * localMatrix;
+        u32 depth = 0;
+        for (auto parent = hierarchy.parents[i]; parent != HIERARCHY_NO_PARENT; parent = hierarchy.parents[parent])
+            depth++;
+        depths[i] = depth;
+        maxDepth = std::max(maxDepth, depth);
     }
-    else
+
+    // counting sort, destroyed entries have no depth bucket
+    auto depthStarts = arenaAlloc<u32>(memory, maxDepth + 2);
+    for (size_t i = 0; i < size; ++i)
+        if (hierarchy.entities[i])
+            depthStarts[depths[i] + 1]++;
+    for (u32 depth = 0; depth <= maxDepth; ++depth)
+        depthStarts[depth + 1] += depthStarts[depth];
+    const auto liveCount = depthStarts[maxDepth + 1];
+
+    auto newIndices = arenaAlloc<u32>(memory, size + 1);
+    for (size_t i = 0; i < size; ++i)
+        newIndices[i] = hierarchy.entities[i] ? depthStarts[depths[i]]++ : HIERARCHY_NO_PARENT;
+
+    const auto reorder = [&]<typename T>(T* values)
+    {
+        auto old = arenaAlloc<T>(memory, size + 1);
+        memcpy(old, values, size * sizeof(T));
+        for (size_t i = 0; i < size; ++i)
+            if (newIndices[i] != HIERARCHY_NO_PARENT)
+                values[newIndices[i]] = old[i];
+    };
+
+    for (size_t i = 0; i < size; ++i)
+        if (hierarchy.parents[i] != HIERARCHY_NO_PARENT)
+            hierarchy.parents[i] = newIndices[hierarchy.parents[i]];
+
+    reorder(hierarchy.entities);
+    reorder(hierarchy.parents);
+    reorder(hierarchy.positions);
+    reorder(hierarchy.rotations);
+    reorder(hierarchy.scales);
+    reorder(hierarchy.worldTransforms);
+    reorder(hierarchy.inverseWorldTransforms);
+    reorder(hierarchy.dirty);
+    reorder(hierarchy.changed);
+    reorder(hierarchy.derived);
+
+    hierarchy.size = liveCount;
+    hierarchy.needsSort = false;
+
+    for (size_t i = 0; i < hierarchy.size; ++i)
+        getEntity(hierarchy.entities[i])->hierarchyIndex = (u32)i;
+}
+
+static void hierarchyAdd(TransformHierarchy& hierarchy, Entity& entity)
+{
+    if (hierarchy.size == hierarchy.capacity && hierarchy.needsSort)
+        hierarchySort(hierarchy);
+    ENSURE(hierarchy.size < hierarchy.capacity);
+
+    const auto index = (u32)hierarchy.size++;
+    hierarchy.entities[index] = entity.handle;
+    hierarchy.parents[index] = entity.parent ? getEntity(entity.parent)->hierarchyIndex : HIERARCHY_NO_PARENT;
+    hierarchy.positions[index] = entity.position;
+    hierarchy.rotations[index] = entity.rotation;
+    hierarchy.scales[index] = entity.scale;
+    hierarchy.dirty[index] = true;
+    hierarchy.changed[index] = true;
+    hierarchy.derived[index] = 0;
+    entity.hierarchyIndex = index;
+
+    if (hierarchy.parents[index] != HIERARCHY_NO_PARENT && hierarchy.parents[index] > index)
+        hierarchy.needsSort = true;
+}
+
+static void hierarchyRemove(TransformHierarchy& hierarchy, Entity const& entity)
+{
+    const auto index = entity.hierarchyIndex;
+    hierarchy.entities[index] = {};
+    hierarchy.parents[index] = HIERARCHY_NO_PARENT;
+    hierarchy.dirty[index] = false;
+    hierarchy.changed[index] = false;
+    hierarchy.needsSort = true;
+}
+
+Entity* createEntity(Entity const& from)
+{
+    ENSURE(g_context);
+    const auto handle = slotMapInsert(g_context->entityManager.entities, from);
+    auto entity = getEntity(handle);
+    entity->handle = handle;
+    hierarchyAdd(getHierarchy(), *entity);
+    return entity;
+}
+
+// the local transforms of a range are built in one batch in place, then multiplied by the parent's world transform.
+// a parent inside the range comes before its children, so it's already finished when they read it
+static void calculateWorldTransforms(TransformHierarchy& hierarchy, u32 begin, u32 end)
+{
+    transformsToAffines(hierarchy.positions + begin, hierarchy.rotations + begin, hierarchy.scales + begin,
+        hierarchy.worldTransforms + begin, end - begin);
+
+    for (auto index = begin; index < end; ++index)
     {
-        entity.worldMatrixCache = localMatrix;
+        if (const auto parent = hierarchy.parents[index]; parent != HIERARCHY_NO_PARENT)
+            hierarchy.worldTransforms[index] = affineMultiply(hierarchy.worldTransforms[parent], hierarchy.worldTransforms[index]);
+        hierarchy.dirty[index] = false;
+        hierarchy.changed[index] = true;
+        hierarchy.derived[index] = 0;
     }
+}
 
-    entity.isWorldMatrixDirty = false;
+static void resolveWorldTransform(TransformHierarchy& hierarchy, u32 index)
+{
+    if (!hierarchy.dirty[index])
+        return;
+    if (const auto parent = hierarchy.parents[index]; parent != HIERARCHY_NO_PARENT)
+        resolveWorldTransform(hierarchy, parent);
+    calculateWorldTransforms(hierarchy, index, index + 1);
+}
 
-    entity.worldPosition = matrixExtractPosition(entity.worldMatrixCache);
-    entity.worldScale = matrixExtractScale(entity.worldMatrixCache);
-    ENSURE(entity.worldScale.x > 0.f && entity.worldScale.y > 0.f && entity.worldScale.z > 0.f);
-    matrixExtractRotation(entity.worldMatrixCache, entity.worldScale, entity.worldRotation, entity.worldEuler);
+Entity& updateWorldTransform(Entity& entity)
+{
+    resolveWorldTransform(getHierarchy(), entity.hierarchyIndex);
+    return entity;
+}
 
-    return entity.worldMatrixCache;
+Affine const& getWorldTransform(Entity& entity)
+{
+    auto& hierarchy = getHierarchy();
+    resolveWorldTransform(hierarchy, entity.hierarchyIndex);
+    return hierarchy.worldTransforms[entity.hierarchyIndex];
 }
 
-static void updateShaderMVP(Entity& entity, Entity& camera)
+static constexpr u8 DERIVED_SCALE = BIT(0);
+static constexpr u8 DERIVED_ROTATION = BIT(1);
+static constexpr u8 DERIVED_EULER = BIT(2);
+static constexpr u8 DERIVED_INVERSE = BIT(3);
+
+Affine const& getInverseWorldTransform(Entity& entity)
 {
-    const auto model = entity.worldMatrixCache;
-    const auto view = camera.view;
-    const auto projection = camera.perspective;
+    const auto& worldTransform = getWorldTransform(entity);
+    auto& hierarchy = getHierarchy();
+    const auto index = entity.hierarchyIndex;
+    if (!(hierarchy.derived[index] & DERIVED_INVERSE))
+    {
+        hierarchy.inverseWorldTransforms[index] = entity.parent ? affineInverse(worldTransform)
+                                                                : transformToInverseAffine(entity.position, entity.rotation, entity.scale);
+        hierarchy.derived[index] |= DERIVED_INVERSE;
+    }
+    return hierarchy.inverseWorldTransforms[index];
+}
 
-    ENSURE(entity.drawCommand != nullptr);
+vec3 getWorldPosition(Entity& entity)
+{
+    return affineExtractPosition(getWorldTransform(entity));
+}
 
-    if (entity.drawCommand->shader == ShaderType::Basic)
-        setShaderVariableMat4(*entity.drawCommand, "world", transpose(model));
+// a root's world transform is its local one, so only children pay for decomposing the matrix
+vec3 getWorldScale(Entity& entity)
+{
+    const auto& worldTransform = getWorldTransform(entity);
+    auto& derived = getHierarchy().derived[entity.hierarchyIndex];
+    if (!(derived & DERIVED_SCALE))
+    {
+        entity.worldScale = entity.parent ? affineExtractScale(worldTransform) : entity.scale;
+        ENSURE(entity.worldScale.x > 0.f && entity.worldScale.y > 0.f && entity.worldScale.z > 0.f);
+        derived |= DERIVED_SCALE;
+    }
+    return entity.worldScale;
+}
 
-    if (hasType(entity, EntityType::Skybox))
-        setShaderVariableMat4(*entity.drawCommand, "mvp", transpose(projection * view));
-    else
-        setShaderVariableMat4(*entity.drawCommand, "mvp", transpose(projection * view * model));
+quat getWorldRotation(Entity& entity)
+{
+    const auto& worldTransform = getWorldTransform(entity);
+    auto& derived = getHierarchy().derived[entity.hierarchyIndex];
+    if (!(derived & DERIVED_ROTATION))
+    {
+        entity.worldRotation = entity.parent ? affineExtractRotation(worldTransform, getWorldScale(entity)) : entity.rotation;
+        derived |= DERIVED_ROTATION;
+    }
+    return entity.worldRotation;
 }
 
-static void calculateCameraView(Entity& camera)
+vec3 getWorldEuler(Entity& entity)
 {
-    const auto rotation = glm::toMat4(camera.worldRotation);
-    const auto target = camera.worldPosition + getForwardVector(rotation);
-    const auto up = getUpVector(rotation);
-    camera.view = lookAtLH(camera.worldPosition, target, up);
+    getWorldTransform(entity);
+    auto& derived = getHierarchy().derived[entity.hierarchyIndex];
+    if (!(derived & DERIVED_EULER))
+    {
+        entity.worldEuler = entity.parent ? quatToEuler(getWorldRotation(entity)) : entity.euler;
+        derived |= DERIVED_EULER;
+    }
+    return entity.worldEuler;
 }
 
-void calculateCameraTransform(Entity& camera, Array<Entity> entities)
+// a dirty entry always has a dirty subtree, so marking stops at entries that are already dirty
+static void markSubtreeDirty(TransformHierarchy& hierarchy, Entity const& entity)
 {
-    calculateCameraView(camera);
-    for (size_t i = 0; i < entities.size; ++i)
+    if (hierarchy.dirty[entity.hierarchyIndex])
+        return;
+
+    hierarchy.dirty[entity.hierarchyIndex] = true;
+    for (auto child = entity.firstChild; child;)
     {
-        auto& entity = entities[i];
-        if (hasType(entity, EntityType::Drawable))
-        {
-            updateShaderMVP(entity, camera);
-        }
+        const auto& childEntity = *getEntity(child);
+        markSubtreeDirty(hierarchy, childEntity);
+        child = childEntity.nextSibling;
     }
 }
 
-void calculateCameraProjection(Entity& camera, vec2 screenSize, Array<Entity> entities)
+static void markTransformDirty(Entity& entity)
+{
+    auto& hierarchy = getHierarchy();
+    const auto index = entity.hierarchyIndex;
+    hierarchy.positions[index] = entity.position;
+    hierarchy.rotations[index] = entity.rotation;
+    hierarchy.scales[index] = entity.scale;
+    markSubtreeDirty(hierarchy, entity);
+}
+
+static void calculateCameraView(Entity& camera)
+{
+    const auto rotation = glm::toMat4(getWorldRotation(camera));
+    const auto position = getWorldPosition(camera);
+    const auto target = position + getForwardVector(rotation);
+    const auto up = getUpVector(rotation);
+    camera.view = lookAtLH(position, target, up);
+}
+
+void calculateCameraProjection(Entity& camera, vec2 screenSize)
 {
     camera.aspect = screenSize.x / screenSize.y;
     auto fov = camera.defaultFov;
@@ -74,42 +273,99 @@ void calculateCameraProjection(Entity& camera, vec2 screenSize, Array<Entity> en
         fov *= 1 / camera.aspect;
     camera.fov = fov;
     camera.perspective = perspectiveLH(radians(camera.fov), camera.aspect, camera.nearZ, camera.farZ);
-    calculateCameraTransform(camera, entities);
+    getHierarchy().changed[camera.hierarchyIndex] = true;
 }
 
-void updateTransform(Entity& entity)
+static void updatePointLightPosition(Entity& light)
 {
-    calculateWorldTransform(entity);
+    ENSURE(g_context);
+    setShaderLightPosition(g_context->render, getWorldPosition(light));
+}
+
+// gathers the world transforms of the active drawables that need a new mvp, builds all of them in one batch
+// and hands them to the draw commands. world transforms only go out when they changed
+static void updateDrawTransforms(TransformHierarchy& hierarchy, Entity const& camera, bool cameraChanged)
+{
+    const auto scratch = arenaScratchBegin();
+    defer({ arenaTempEnd(scratch); });
+    auto& memory = *scratch.arena;
+
+    auto worlds = arenaAlloc<Affine>(memory, hierarchy.size + 1);
+    auto drawCommands = arenaAlloc<DrawCommand*>(memory, hierarchy.size + 1);
+    size_t count = 0;
 
-    ENSURE(g_context != nullptr);
-    if (hasType(entity, EntityType::Camera))
+    for (u32 i = 0; i < hierarchy.size; ++i)
     {
-        calculateCameraTransform(entity, g_context->entityManager.entities);
+        const auto changed = hierarchy.changed[i];
+        if (!changed && !cameraChanged)
+            continue;
+        hierarchy.changed[i] = false;
+
+        auto& entity = *getEntity(hierarchy.entities[i]);
+        if (changed && hasType(entity, EntityType::Light) && entity.lightType == LightType::Point)
+            updatePointLightPosition(entity);
+
+        // the skybox only reads the shared view-projection, inactive drawables are marked changed when activated
+        if (!hasType(entity, EntityType::Drawable) || hasType(entity, EntityType::Skybox))
+            continue;
+        const auto drawCommand = getDrawCommand(entity);
+        ENSURE(drawCommand != nullptr);
+        if (!bool(drawCommand->flags & DrawFlag::Active))
+            continue;
+
+        if (changed)
+            setShaderVariable(*drawCommand, ShaderSlot::World, hierarchy.worldTransforms[i]);
+
+        worlds[count] = hierarchy.worldTransforms[i];
+        drawCommands[count] = drawCommand;
+        count++;
     }
-    else if (hasType(entity, EntityType::Drawable))
+
+    auto mvps = arenaAlloc<mat4>(memory, count + 1);
+    transformsToClipMatrices(camera.viewProjection, worlds, mvps, count);
+    for (size_t i = 0; i < count; ++i)
     {
-        updateShaderMVP(entity, g_context->entityManager.camera);
+        setShaderVariable(*drawCommands[i], ShaderSlot::Mvp, mvps[i]);
+        // the clip w of the origin, the matrix is transposed but [3][3] is on the diagonal
+        drawCommands[i]->depth = mvps[i][3][3];
     }
+}
 
-    if (hasType(entity, EntityType::Light))
-    {
-        if (entity.lightType == LightType::Directional)
-            return;
+void flushTransforms(EntityManager& manager)
+{
+    auto& hierarchy = manager.hierarchy;
 
-        for (const auto& drawable : g_context->entityManager.entities)
+    if (hierarchy.needsSort)
+        hierarchySort(hierarchy);
+
+    // parents come first, so their world matrix is always up to date when a child reads it.
+    // dirty entries are processed in runs so their local matrices can be built in batches
+    for (u32 begin = 0; begin < hierarchy.size;)
+    {
+        if (!hierarchy.dirty[begin])
         {
-            if (hasType(drawable, EntityType::Drawable))
-            {
-                ENSURE(drawable.drawCommand != nullptr);
-                if (drawable.drawCommand->shader == ShaderType::Basic)
-                    setShaderVariableVec3(*drawable.drawCommand, "lightPosition", entity.worldPosition);
-            }
+            begin++;
+            continue;
         }
+
+        auto end = begin + 1;
+        while (end < hierarchy.size && hierarchy.dirty[end])
+            end++;
+        calculateWorldTransforms(hierarchy, begin, end);
+        begin = end;
+    }
+
+    auto& camera = getCamera();
+    const auto cameraChanged = hierarchy.changed[camera.hierarchyIndex];
+    if (cameraChanged)
+    {
+        calculateCameraView(camera);
+        camera.viewProjection = camera.perspective * camera.view;
+        ENSURE(g_context);
+        setShaderCamera(g_context->render, camera.viewProjection, getWorldPosition(camera));
     }
 
-    for (auto& child : entity.children)
-        if (child)
-            updateTransform(*child);
+    updateDrawTransforms(hierarchy, camera, cameraChanged);
 }
 
 bool hasType(Entity const& entity, EntityType type)
@@ -120,8 +376,7 @@ bool hasType(Entity const& entity, EntityType type)
 void setLocalPosition(Entity& entity, vec3 pos)
 {
     entity.position = pos;
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void addLocalPosition(Entity& entity, vec3 pos)
@@ -134,8 +389,7 @@ void setLocalScale(Entity& entity, float scale)
     scale = std::max(scale, 0.00001f);
 
     entity.scale = vec3(scale, scale, scale);
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void setLocalScale(Entity& entity, vec3 scale)
@@ -145,8 +399,7 @@ void setLocalScale(Entity& entity, vec3 scale)
     scale.z = std::max(scale.z, 0.00001f);
 
     entity.scale = scale;
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void setLocalRotation(Entity& entity, vec3 rot)
@@ -166,8 +419,7 @@ void setLocalRotation(Entity& entity, vec3 rot)
 
     entity.rotation = eulerToQuat(rot);
     entity.euler = rot;
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void addLocalRotation(Entity& entity, vec3 euler)
@@ -183,16 +435,15 @@ void setWorldPosition(Entity& entity, vec3 pos)
     }
     else
     {
-        entity.position = worldToLocal(pos, entity.parent->worldMatrixCache);
+        entity.position = affineTransformPoint(getInverseWorldTransform(*getEntity(entity.parent)), pos);
     }
 
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void addWorldPosition(Entity& entity, vec3 pos)
 {
-    setWorldPosition(entity, entity.worldPosition + pos);
+    setWorldPosition(entity, getWorldPosition(entity) + pos);
 }
 
 void setWorldRotation(Entity& entity, vec3 rot)
@@ -218,17 +469,16 @@ void setWorldRotation(Entity& entity, vec3 rot)
     else
     {
         const auto worldRotation = eulerToQuat(rot);
-        entity.rotation = worldToLocal(worldRotation, entity.parent->worldMatrixCache);
+        entity.rotation = worldToLocal(worldRotation, getWorldRotation(*getEntity(entity.parent)));
         entity.euler = quatToEuler(entity.rotation);
     }
 
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void addWorldRotation(Entity& entity, vec3 euler)
 {
-    setWorldRotation(entity, entity.worldEuler + euler);
+    setWorldRotation(entity, getWorldEuler(entity) + euler);
 }
 
 void setWorldScale(Entity& entity, vec3 scale)
@@ -243,33 +493,83 @@ void setWorldScale(Entity& entity, vec3 scale)
     }
     else
     {
-        entity.scale = scale / entity.parent->worldScale;
+        entity.scale = scale / getWorldScale(*getEntity(entity.parent));
     }
 
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
+}
+
+static void detachFromParent(Entity& entity)
+{
+    if (!entity.parent)
+        return;
+
+    auto& parent = *getEntity(entity.parent);
+    if (entity.prevSibling)
+        getEntity(entity.prevSibling)->nextSibling = entity.nextSibling;
+    else
+        parent.firstChild = entity.nextSibling;
+
+    if (entity.nextSibling)
+        getEntity(entity.nextSibling)->prevSibling = entity.prevSibling;
+    else
+        parent.lastChild = entity.prevSibling;
+
+    entity.parent = {};
+    entity.nextSibling = {};
+    entity.prevSibling = {};
 }
 
-static void findEraseChild(Entity& parent, Entity& child)
+static void attachToParent(Entity& entity, Entity& parent)
 {
-    ENSURE(parent.children);
-    const auto oldParentChildSlot =
-        findIndex(parent.children.data, parent.children.capacity, [&](auto& otherChild) { return otherChild == &child; });
-    ENSURE(oldParentChildSlot != -1);
-    parent.children[oldParentChildSlot] = nullptr;
-    parent.children.size--;
+    entity.parent = parent.handle;
+    entity.prevSibling = parent.lastChild;
+    entity.nextSibling = {};
+
+    if (parent.lastChild)
+        getEntity(parent.lastChild)->nextSibling = entity.handle;
+    else
+        parent.firstChild = entity.handle;
+    parent.lastChild = entity.handle;
+}
+
+void destroyEntity(EntityHandle handle)
+{
+    ENSURE(g_context);
+
+    auto entity = getEntity(handle);
+    if (!entity)
+        return;
+
+    // destroying moves entities around in the slot map, so the entity is fetched again after each child.
+    // every destroyed child unlinks itself, so the first child is always the next one
+    while (entity->firstChild)
+    {
+        destroyEntity(entity->firstChild);
+        entity = getEntity(handle);
+    }
+
+    detachFromParent(*entity);
+
+    hierarchyRemove(getHierarchy(), *entity);
+
+    if (entity->drawCommand)
+        freeDrawCmd(g_context->render, entity->drawCommand);
+
+    if (g_context->gui.selectedEntity == handle)
+        g_context->gui.selectedEntity = {};
+
+    slotMapErase(g_context->entityManager.entities, handle);
 }
 
 void setParent(Entity& entity, Entity* newParent, bool keepWorldTransform)
 {
     if (!newParent)
     {
-        if (entity.parent)
-            findEraseChild(*entity.parent, entity);
-        entity.parent = nullptr;
+        detachFromParent(entity);
+        getHierarchy().parents[entity.hierarchyIndex] = HIERARCHY_NO_PARENT;
 
-        entity.isWorldMatrixDirty = true;
-        updateTransform(entity);
+        markTransformDirty(entity);
 
         return;
     }
@@ -277,23 +577,22 @@ void setParent(Entity& entity, Entity* newParent, bool keepWorldTransform)
     if (&entity == newParent)
         return;
 
-    if (entity.parent && newParent == entity.parent)
+    if (entity.parent && newParent->handle == entity.parent)
         return;
 
-    if (!newParent->children)
-        arrayInit(newParent->children, 1024, g_context->gameMemory);
-
-    const auto newChildSlot =
-        findIndex(newParent->children.data, newParent->children.capacity, [](auto& child) { return child == nullptr; });
-    if (newChildSlot == -1)
-        return;
+    // parenting to one of its own descendants would make a cycle
+    for (auto ancestor = newParent->parent; ancestor; ancestor = getEntity(ancestor)->parent)
+        if (ancestor == entity.handle)
+            return;
 
-    if (entity.parent)
-        findEraseChild(*entity.parent, entity);
+    detachFromParent(entity);
+    attachToParent(entity, *newParent);
 
-    entity.parent = &*newParent;
-    newParent->children[newChildSlot] = &entity;
-    newParent->children.size++;
+    // the sweep needs the parent first, the order is only rebuilt when that stops being true
+    auto& hierarchy = getHierarchy();
+    hierarchy.parents[entity.hierarchyIndex] = newParent->hierarchyIndex;
+    if (newParent->hierarchyIndex > entity.hierarchyIndex)
+        hierarchy.needsSort = true;
 
     if (!keepWorldTransform)
     {
@@ -303,22 +602,15 @@ void setParent(Entity& entity, Entity* newParent, bool keepWorldTransform)
         entity.scale = vec3(1.f, 1.f, 1.f);
     }
 
-    entity.isWorldMatrixDirty = true;
-    updateTransform(entity);
+    markTransformDirty(entity);
 }
 
 void setColor(Entity& entity, vec4 color)
 {
     ENSURE(g_context);
-    setShaderVariableVec4(*entity.drawCommand, "objectColor", color);
+    setShaderVariable(*getDrawCommand(entity), ShaderSlot::ObjectColor, color);
     if (hasType(entity, EntityType::Light))
-    {
-        for (auto& other : g_context->entityManager.entities)
-        {
-            if (hasType(other, EntityType::Drawable) && other.drawCommand->shader == ShaderType::Basic)
-                setShaderVariableVec4(*other.drawCommand, "lightColor", color);
-        }
-    }
+        setShaderLightColor(g_context->render, color);
 }
 
 void setLightType(Entity& light, LightType type)
@@ -327,12 +619,11 @@ void setLightType(Entity& light, LightType type)
     ENSURE(hasType(light, EntityType::Light));
 
     light.lightType = type;
+    setShaderLightType(g_context->render, (i32)type);
 
-    for (auto& other : g_context->entityManager.entities)
-    {
-        if (hasType(other, EntityType::Drawable) && other.drawCommand->shader == ShaderType::Basic)
-            setShaderVariableInt(*other.drawCommand, "lightType", (i32)type);
-    }
+    // the position only reaches the shaders when the light moves, a light that just became a point light has to send it
+    if (type == LightType::Point)
+        updatePointLightPosition(light);
 }
 
 void setLightDirection(Entity& light, vec3 direction)
@@ -341,14 +632,7 @@ void setLightDirection(Entity& light, vec3 direction)
     ENSURE(hasType(light, EntityType::Light));
 
     light.lightDirection = direction;
-
-    for (const auto& entity : g_context->entityManager.entities)
-    {
-        if (hasType(entity, EntityType::Drawable) && entity.drawCommand->shader == ShaderType::Basic)
-        {
-            setShaderVariableVec3(*entity.drawCommand, "lightDirection", light.lightDirection);
-        }
-    }
+    setShaderLightDirection(g_context->render, light.lightDirection);
 }
 
 void setEntityFlag(Entity& entity, EntityFlag flag)
@@ -372,27 +656,30 @@ void setEntityFlag(Entity& entity, EntityFlag flag)
     processSingleFlag(EntityFlag::Active,
         [](Entity& entity, bool isSet)
         {
-            if (entity.drawCommand)
+            if (const auto drawCommand = getDrawCommand(entity); drawCommand)
             {
                 if (isSet)
-                    entity.drawCommand->flags |= DrawFlag::Active;
+                {
+                    drawCommand->flags |= DrawFlag::Active;
+                    // its mvp wasn't kept up to date while it was inactive
+                    getHierarchy().changed[entity.hierarchyIndex] = true;
+                }
                 else
-                    entity.drawCommand->flags &= ~(DrawFlag::Active);
+                {
+                    drawCommand->flags &= ~(DrawFlag::Active);
+                }
             }
         });
 
-    for (const auto& child : entity.children)
-    {
-        if (!child)
-            continue;
-        setEntityFlag(*child, flag);
-    }
+    for (auto child = entity.firstChild; child; child = getEntity(child)->nextSibling)
+        setEntityFlag(*getEntity(child), flag);
 }
 
 void setTexture(Entity& entity, size_t slot, Texture& texture)
 {
-    ENSURE(hasType(entity, EntityType::Drawable) && entity.drawCommand && slot < MAX_TEXTURE_SLOTS);
-    entity.drawCommand->textures[slot] = &texture;
+    const auto drawCommand = getDrawCommand(entity);
+    ENSURE(hasType(entity, EntityType::Drawable) && drawCommand && slot < MAX_TEXTURE_SLOTS);
+    drawCommand->textures[slot] = &texture;
 }
 
 vec3 getForwardVector(Entity& entity)
@@ -412,15 +699,15 @@ vec3 getUpVector(Entity& entity)
 
 vec3 getWorldForwardVector(Entity& entity)
 {
-    return getForwardVector(toMat4(entity.worldRotation));
+    return getForwardVector(toMat4(getWorldRotation(entity)));
 }
 
 vec3 getWorldRightVector(Entity& entity)
 {
-    return getRightVector(toMat4(entity.worldRotation));
+    return getRightVector(toMat4(getWorldRotation(entity)));
 }
 
 vec3 getWorldUpVector(Entity& entity)
 {
-    return getUpVector(toMat4(entity.worldRotation));
+    return getUpVector(toMat4(getWorldRotation(entity)));
 }
@@ -2,8 +2,13 @@
 
 #include "common/common.hpp"
 #include "common/array.hpp"
+#include "common/slot_map.hpp"
 
 struct DrawCommand;
+struct Entity;
+
+using EntityHandle = Handle<Entity>;
+using DrawCommandHandle = Handle<DrawCommand>;
 
 enum class EntityType
 {
@@ -32,8 +37,13 @@ enum class LightType
 struct Entity
 {
     String name;
-    Entity* parent;
-    Array<Entity*> children;
+    EntityHandle handle;
+    EntityHandle parent;
+    // children form a doubly linked list through their sibling handles
+    EntityHandle firstChild;
+    EntityHandle lastChild;
+    EntityHandle nextSibling;
+    EntityHandle prevSibling;
     EntityFlag flags;
     EntityType type;
 
@@ -42,13 +52,13 @@ struct Entity
     vec3 euler;
     vec3 scale;
 
-    vec3 worldPosition;
+    // derived from the world matrix on first read after it changes, read them through getWorld*
     quat worldRotation;
     vec3 worldEuler;
     vec3 worldScale;
 
-    mat4 worldMatrixCache;
-    bool isWorldMatrixDirty;
+    // setters only mark the entity and its subtree dirty, world values are recomputed on read or in flushTransforms
+    u32 hierarchyIndex;
 
     // camera
     float defaultFov;
@@ -58,9 +68,10 @@ struct Entity
     float farZ;
     mat4 view;
     mat4 perspective;
+    mat4 viewProjection;  // perspective * view, computed once per frame when the camera changed
 
     // drawable
-    struct DrawCommand* drawCommand;
+    DrawCommandHandle drawCommand;
 
     // light
     vec3 lightDirection;
@@ -69,13 +80,69 @@ struct Entity
     bool guiIsLocal;
 };
 
+static constexpr u32 HIERARCHY_NO_PARENT = ~0u;
+
+// local and world transforms in flat arrays where a parent always comes before its children, so world matrices
+// are computed in one forward sweep. reparenting that breaks the order re-sorts the arrays by depth before the
+// next sweep. a dirty entry's whole subtree is dirty as well
+struct TransformHierarchy
+{
+    EntityHandle* entities;  // invalid for entries of destroyed entities until the next sort
+    u32* parents;
+    vec3* positions;
+    quat* rotations;
+    vec3* scales;
+    Affine* worldTransforms;
+    Affine* inverseWorldTransforms;  // computed on first use, valid while derived says so
+    bool* dirty;
+    bool* changed;  // shader variables haven't seen the new world matrix yet
+    u8* derived;    // which of the inverse transform and the entity's world rotation, euler and scale match the current matrix
+    size_t size;
+    size_t capacity;
+    bool needsSort;
+};
+
 struct EntityManager
 {
-    Entity camera;
-    Array<Entity> entities;
+    EntityHandle camera;
+    SlotMap<Entity> entities;
+    TransformHierarchy hierarchy;
 };
 
-void updateTransform(Entity& entity);
+inline void hierarchyInit(TransformHierarchy& hierarchy, size_t capacity, Arena& arena)
+{
+    hierarchy.entities = arenaAlloc<EntityHandle>(arena, capacity);
+    hierarchy.parents = arenaAlloc<u32>(arena, capacity);
+    hierarchy.positions = arenaAlloc<vec3>(arena, capacity);
+    hierarchy.rotations = arenaAlloc<quat>(arena, capacity);
+    hierarchy.scales = arenaAlloc<vec3>(arena, capacity);
+    hierarchy.worldTransforms = arenaAlloc<Affine>(arena, capacity);
+    hierarchy.inverseWorldTransforms = arenaAlloc<Affine>(arena, capacity);
+    hierarchy.dirty = arenaAlloc<bool>(arena, capacity);
+    hierarchy.changed = arenaAlloc<bool>(arena, capacity);
+    hierarchy.derived = arenaAlloc<u8>(arena, capacity);
+    hierarchy.size = 0;
+    hierarchy.capacity = capacity;
+    hierarchy.needsSort = false;
+}
+
+// entities move around in memory when others are destroyed, anything stored across frames keeps a handle
+Entity* getEntity(EntityHandle handle);
+Entity& getCamera();
+DrawCommand* getDrawCommand(Entity const& entity);
+
+Entity* createEntity(Entity const& entity);
+void destroyEntity(EntityHandle handle);
+
+Entity& updateWorldTransform(Entity& entity);
+Affine const& getWorldTransform(Entity& entity);
+Affine const& getInverseWorldTransform(Entity& entity);
+vec3 getWorldPosition(Entity& entity);
+quat getWorldRotation(Entity& entity);
+vec3 getWorldEuler(Entity& entity);
+vec3 getWorldScale(Entity& entity);
+void flushTransforms(EntityManager& manager);  // once per frame before drawing
+void calculateCameraProjection(Entity& camera, vec2 screenSize);
 
 void setLocalPosition(Entity& entity, vec3 pos);
 void addLocalPosition(Entity& entity, vec3 pos);
@@ -7,6 +7,7 @@
 #include "geometry.cpp"
 #include "renderer.hpp"
 #include "shaders.cpp"
+#include "renderer.cpp"
 #include "renderer_dx11.cpp"
 #include "gui.cpp"
 #include "entity.cpp"
@@ -21,37 +22,34 @@ Entity defaultEntity()
     e.name = strL("entity");
     e.flags = EntityFlag::Active;
     e.scale = vec3(1.f, 1.f, 1.f);
-    e.isWorldMatrixDirty = true;
     e.guiIsLocal = true;
     return e;
 }
 
 Entity* pushEntity()
 {
-    auto entity = defaultEntity();
-    return arrayPush(g_context->entityManager.entities, entity);
+    return createEntity(defaultEntity());
 }
 
-Entity* pushDrawable(RenderState& renderState, GeneratedMesh meshType, ShaderType shader = ShaderType::Unlit)
+Entity* pushDrawable(RenderState& renderState, Mesh& mesh, ShaderType shader = ShaderType::Unlit)
 {
     auto entity = defaultEntity();
     entity.type = EntityType::Drawable;
 
-    entity.drawCommand = pushDrawCmd(renderState, renderState.generatedMeshes[(i32)meshType], shader);
-    entity.name = entity.drawCommand->mesh->name;
+    entity.drawCommand = pushDrawCmd(renderState, mesh, shader);
+    entity.name = mesh.name;
 
-    return arrayPush(g_context->entityManager.entities, entity);
+    return createEntity(entity);
 }
 
-Entity* pushDrawable(RenderState& renderState, const char* meshName, ShaderType shader = ShaderType::Unlit)
+Entity* pushDrawable(RenderState& renderState, GeneratedMesh meshType, ShaderType shader = ShaderType::Unlit)
 {
-    auto entity = defaultEntity();
-    entity.type = EntityType::Drawable;
-
-    entity.drawCommand = pushDrawCmd(renderState, renderGetMesh(renderState, strSz(meshName)), shader);
-    entity.name = entity.drawCommand->mesh->name;
+    return pushDrawable(renderState, renderState.generatedMeshes[(i32)meshType], shader);
+}
 
-    return arrayPush(g_context->entityManager.entities, entity);
+Entity* pushDrawable(RenderState& renderState, AssetId meshId, ShaderType shader = ShaderType::Unlit)
+{
+    return pushDrawable(renderState, renderGetMesh(renderState, meshId), shader);
 }
 
 Entity* pushLight(RenderState& renderState, LightType type)
@@ -59,43 +57,46 @@ Entity* pushLight(RenderState& renderState, LightType type)
     auto entity = defaultEntity();
     entity.type = EntityType::Light | EntityType::Drawable;
 
-    entity.drawCommand = pushDrawCmd(renderState, renderGetMesh(renderState, strL("bulb")), ShaderType::Unlit);
+    entity.drawCommand = pushDrawCmd(renderState, renderGetMesh(renderState, ASSET_ID("bulb")), ShaderType::Unlit);
 
     entity.name = strL("light");
 
-    setLightType(entity, type);
+    const auto light = createEntity(entity);
+
+    setLightType(*light, type);
 
     if (type == LightType::Directional)
     {
-        setLightDirection(entity,
-            {Shaders::DEFAULT_VARIABLES.lightDirection[0],
-                Shaders::DEFAULT_VARIABLES.lightDirection[1],
-                Shaders::DEFAULT_VARIABLES.lightDirection[2]});
+        setLightDirection(*light,
+            {Shaders::DEFAULT_LIGHT_VARIABLES.lightDirection[0],
+                Shaders::DEFAULT_LIGHT_VARIABLES.lightDirection[1],
+                Shaders::DEFAULT_LIGHT_VARIABLES.lightDirection[2]});
     }
 
-    setColor(entity, vec4(1, 1, 1, 1));
-    setLocalScale(entity, vec3(0.5f));
+    setColor(*light, vec4(1, 1, 1, 1));
+    setLocalScale(*light, vec3(0.5f));
 
-    return arrayPush(g_context->entityManager.entities, entity);
+    return light;
 }
 
 Entity* pushSkybox(RenderState& render)
 {
     const auto box = pushDrawable(render, GeneratedMesh::Cube, ShaderType::Skybox);
     box->type |= EntityType::Skybox;
-    setTexture(*box, 0, renderGetCubemap(render, strL("skybox")));
+    setTexture(*box, 0, renderGetCubemap(render, ASSET_ID("skybox")));
     return box;
 }
 
 void generateNormalArrows(RenderState& render, Entity& entity)
 {
-    auto& mesh = *entity.drawCommand->mesh;
+    auto& mesh = *getDrawCommand(entity)->mesh;
+    auto& arrowMesh = renderGetMesh(render, ASSET_ID("arrow"));
     for (size_t i = 0; i < mesh.verticesCount; ++i)
     {
         auto vertex = mesh.vertices[i];
-        const auto arrow = pushDrawable(render, "arrow");
+        const auto arrow = pushDrawable(render, arrowMesh);
         setParent(*arrow, &entity);
-        const auto worldArrowPos = entity.worldMatrixCache * vec4(vertex.pos, 1.f);
+        const auto worldArrowPos = affineTransformPoint(getWorldTransform(entity), vertex.pos);
         setWorldPosition(*arrow, worldArrowPos);
         setLocalScale(*arrow, 0.05f);
         setLocalRotation(*arrow, directionToEuler(vertex.normal));
@@ -105,7 +106,7 @@ void generateNormalArrows(RenderState& render, Entity& entity)
 
 void onResize(Context& ctx)
 {
-    calculateCameraProjection(ctx.entityManager.camera, ctx.render.screenSize, ctx.entityManager.entities);
+    calculateCameraProjection(getCamera(), ctx.render.screenSize);
 }
 
 void gameInit(Context& ctx)
@@ -113,6 +114,7 @@ void gameInit(Context& ctx)
     logInfo("game init");
 
     g_context = &ctx;
+    arenaScratchInit(ctx.tempMemory, ctx.scratchMemory);
 
     renderInitResources(ctx.render, ctx.platform.assets);
     renderInit(ctx.render, ctx.platform.window);
@@ -121,9 +123,7 @@ void gameInit(Context& ctx)
     defer({
         // pushSkybox(ctx.render);
 
-        for (auto& entity : ctx.entityManager.entities)
-            if (hasType(entity, EntityType::Drawable))
-                updateTransform(entity);
+        flushTransforms(ctx.entityManager);
     });
 
     auto camera = defaultEntity();
@@ -133,29 +133,32 @@ void gameInit(Context& ctx)
     camera.nearZ = 0.001f;
     camera.farZ = 1000.f;
 
-    setLocalPosition(camera, vec3(0, 0, -5));
-    ctx.entityManager.camera = camera;
+    ctx.entityManager.camera = createEntity(camera)->handle;
+    setLocalPosition(getCamera(), vec3(0, 0, -5));
 
     onResize(ctx);
 
-    ctx.gameState.grid = pushDrawable(ctx.render, GeneratedMesh::Grid, ShaderType::Unlit);
-    ctx.gameState.grid->drawCommand->rasterizerState = RasterizerState::Wireframe;
-    ctx.gameState.grid->name = strL("grid");
-    setColor(*ctx.gameState.grid, vec4(0.5, 0.5, 0.5, 1));
+    const auto grid = pushDrawable(ctx.render, GeneratedMesh::Grid, ShaderType::Unlit);
+    getDrawCommand(*grid)->rasterizerState = RasterizerState::Wireframe;
+    grid->name = strL("grid");
+    setColor(*grid, vec4(0.5, 0.5, 0.5, 1));
+    ctx.gameState.grid = grid->handle;
 
-    // ctx.gameState.sphere = pushDrawable(ctx.render, GeneratedMesh::Sphere, ShaderType::Basic);
-    // setLocalPosition(*ctx.gameState.sphere, vec3(1.f, 0.f, 0.f));
-    // setTexture(*ctx.gameState.sphere, 0, renderGetTexture(ctx.render, strL("earth")));
+    // const auto sphere = pushDrawable(ctx.render, GeneratedMesh::Sphere, ShaderType::Basic);
+    // setLocalPosition(*sphere, vec3(1.f, 0.f, 0.f));
+    // setTexture(*sphere, 0, renderGetTexture(ctx.render, ASSET_ID("earth")));
+    // ctx.gameState.sphere = sphere->handle;
 
     ctx.gameState.cameraController = {};
-    ctx.gameState.cameraController.camera = &ctx.entityManager.camera;
+    ctx.gameState.cameraController.camera = ctx.entityManager.camera;
     ctx.gameState.cameraController.speed = 1.f;
     ctx.gameState.cameraController.sensitivity = 5.f;
 
-    // ctx.gameState.light = pushLight(ctx.render, LightType::Directional);
-    // setLocalPosition(*ctx.gameState.light, vec3(-1, 0, -1));
+    // const auto light = pushLight(ctx.render, LightType::Directional);
+    // setLocalPosition(*light, vec3(-1, 0, -1));
+    // ctx.gameState.light = light->handle;
 
-    setLocalPosition(ctx.entityManager.camera, vec3(0, 2.5, -7));
+    setLocalPosition(getCamera(), vec3(0, 2.5, -7));
 }
 
 void gamePreHotReload(Context& ctx)
@@ -170,39 +173,41 @@ void gamePostHotReload(Context& ctx)
 
 void cameraControllerMoveAndRotate(float dt, CameraController& controller)
 {
+    auto& camera = *getEntity(controller.camera);
+
     controller.speed = CameraController::DEFAULT_SPEED;
     if (isKeyPressed(KeyboardKey::KEY_SHIFT))
         controller.speed *= 10.f;
 
     if (isKeyPressed(KeyboardKey::KEY_Q))
     {
-        addLocalPosition(*controller.camera, getUpVector(*controller.camera) * dt * -controller.speed);
+        addLocalPosition(camera, getUpVector(camera) * dt * -controller.speed);
     }
     if (isKeyPressed(KeyboardKey::KEY_E))
     {
-        addLocalPosition(*controller.camera, getUpVector(*controller.camera) * dt * controller.speed);
+        addLocalPosition(camera, getUpVector(camera) * dt * controller.speed);
     }
     if (isKeyPressed(KeyboardKey::KEY_D))
     {
-        addLocalPosition(*controller.camera, getRightVector(*controller.camera) * dt * controller.speed);
+        addLocalPosition(camera, getRightVector(camera) * dt * controller.speed);
     }
     if (isKeyPressed(KeyboardKey::KEY_A))
     {
-        addLocalPosition(*controller.camera, getRightVector(*controller.camera) * dt * -controller.speed);
+        addLocalPosition(camera, getRightVector(camera) * dt * -controller.speed);
     }
     if (isKeyPressed(KeyboardKey::KEY_W))
     {
-        addLocalPosition(*controller.camera, getForwardVector(*controller.camera) * dt * controller.speed);
+        addLocalPosition(camera, getForwardVector(camera) * dt * controller.speed);
     }
     if (isKeyPressed(KeyboardKey::KEY_S))
     {
-        addLocalPosition(*controller.camera, getForwardVector(*controller.camera) * dt * -controller.speed);
+        addLocalPosition(camera, getForwardVector(camera) * dt * -controller.speed);
     }
 
     controller.pitchYawTarget += controller.pitchYawDelta * controller.sensitivity * dt;
     controller.pitchYaw =
         lerp(controller.pitchYaw, controller.pitchYawTarget, min(CameraController::PITCH_YAW_SMOOTHING * dt, 1.f));
-    setLocalRotation(*controller.camera, controller.pitchYaw);
+    setLocalRotation(camera, controller.pitchYaw);
     controller.pitchYawDelta = {};
 }
 
@@ -267,13 +272,13 @@ void guiEntityContents(Context& ctx, Entity& entity)
     }
     else
     {
-        auto pos = entity.worldPosition;
+        auto pos = getWorldPosition(entity);
         if (ImGui::DragFloat3("pos", &pos.x, 0.1f))
         {
             setWorldPosition(entity, pos);
         }
 
-        auto rot = entity.worldEuler;
+        auto rot = getWorldEuler(entity);
         if (ImGui::DragFloat3("rot", &rot.x, 0.1f))
         {
             setWorldRotation(entity, rot);
@@ -281,7 +286,7 @@ void guiEntityContents(Context& ctx, Entity& entity)
 
         if (!hasType(entity, EntityType::Camera))
         {
-            auto scale = entity.worldScale;
+            auto scale = getWorldScale(entity);
             if (ImGui::DragFloat3("scale", &scale.x, 0.1f))
             {
                 setWorldScale(entity, scale);
@@ -303,7 +308,7 @@ void guiEntityContents(Context& ctx, Entity& entity)
         if (ImGui::DragFloat("fov", &fov))
         {
             entity.defaultFov = fov;
-            calculateCameraProjection(entity, ctx.render.screenSize, ctx.entityManager.entities);
+            calculateCameraProjection(entity, ctx.render.screenSize);
         }
     }
 
@@ -336,8 +341,9 @@ void guiEntityContents(Context& ctx, Entity& entity)
 
     if (hasType(entity, EntityType::Drawable))
     {
-        ImGui::Text("shader: %s", (entity.drawCommand->shader == ShaderType::Basic) ? "basic" : "unlit");
-        auto color = getShaderVariableVec4(*entity.drawCommand, "objectColor");
+        const auto drawCommand = getDrawCommand(entity);
+        ImGui::Text("shader: %s", (drawCommand->shader == ShaderType::Basic) ? "basic" : "unlit");
+        auto color = getShaderVariable(*drawCommand, ShaderSlot::ObjectColor);
         if (ImGui::ColorEdit4("color", &color.x))
         {
             setColor(entity, color);
@@ -357,8 +363,8 @@ void guiCheckEntityReparentSource(Entity& toReparent)
 {
     if (ImGui::BeginDragDropSource())
     {
-        const auto entityPtr = &toReparent;
-        ImGui::SetDragDropPayload("reparent", &entityPtr, sizeof(void*));
+        const auto handle = toReparent.handle;
+        ImGui::SetDragDropPayload("reparent", &handle, sizeof(handle));
         ImGui::EndDragDropSource();
     }
 }
@@ -369,14 +375,16 @@ void guiCheckEntityReparentTarget(Entity& newParent)
     {
         if (const auto entityPayload = ImGui::AcceptDragDropPayload("reparent"); entityPayload && entityPayload->Data)
         {
-            const auto toReparent = (Entity**)entityPayload->Data;
-            if (isKeyPressed(KeyboardKey::KEY_ALT))
+            if (const auto toReparent = getEntity(*(EntityHandle*)entityPayload->Data); toReparent)
             {
-                setParent(**toReparent, &newParent, false);
-            }
-            else
-            {
-                setParent(**toReparent, &newParent, true);
+                if (isKeyPressed(KeyboardKey::KEY_ALT))
+                {
+                    setParent(*toReparent, &newParent, false);
+                }
+                else
+                {
+                    setParent(*toReparent, &newParent, true);
+                }
             }
         }
         ImGui::EndDragDropTarget();
@@ -400,15 +408,15 @@ void guiEntityHierarchy(Context& ctx, Entity& entity, ImGuiTableFlags flags, u32
 {
     hierarchyLevel++;
 
-    if (hierarchyLevel == 1 && entity.parent != nullptr)
+    if (hierarchyLevel == 1 && entity.parent)
         return;
 
-    const auto hasChildren = (bool)entity.children;
+    const auto hasChildren = (bool)entity.firstChild;
 
     ImGui::TableNextColumn();
     ImGuiTreeNodeFlags nodeFlags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick;
 
-    if (ctx.gui.selectedEntity == &entity)
+    if (ctx.gui.selectedEntity == entity.handle)
     {
         nodeFlags |= ImGuiTreeNodeFlags_Selected;
     }
@@ -426,19 +434,15 @@ void guiEntityHierarchy(Context& ctx, Entity& entity, ImGuiTableFlags flags, u32
 
         if (ImGui::IsItemClicked())
         {
-            ctx.gui.selectedEntity = &entity;
+            ctx.gui.selectedEntity = entity.handle;
         }
 
         ImGui::TableNextColumn();
 
         if (open)
         {
-            for (auto child : entity.children)
-            {
-                if (!child)
-                    continue;
-                guiEntityHierarchy(ctx, *child, nodeFlags, hierarchyLevel);
-            }
+            for (auto child = entity.firstChild; child; child = getEntity(child)->nextSibling)
+                guiEntityHierarchy(ctx, *getEntity(child), nodeFlags, hierarchyLevel);
 
             ImGui::TreePop();
         }
@@ -458,7 +462,7 @@ void guiEntityHierarchy(Context& ctx, Entity& entity, ImGuiTableFlags flags, u32
 
         if (ImGui::IsItemClicked())
         {
-            ctx.gui.selectedEntity = &entity;
+            ctx.gui.selectedEntity = entity.handle;
         }
 
         ImGui::TableNextColumn();
@@ -489,17 +493,14 @@ void onGui(Context& ctx)
             guiEntityHierarchy(ctx, entity, flags, 0);
         }
 
-        if (!ctx.entityManager.camera.parent)
-            guiEntityHierarchy(ctx, ctx.entityManager.camera, flags, 0);
-
         ImGui::EndTable();
     }
 
-    if (ctx.gui.selectedEntity)
+    if (const auto selected = getEntity(ctx.gui.selectedEntity); selected)
     {
         ImGui::Begin("vselenaya");
         ImGui::Text("selected: ");
-        guiEntityContents(ctx, *(Entity*)ctx.gui.selectedEntity);
+        guiEntityContents(ctx, *selected);
         ImGui::End();
     }
 
@@ -521,11 +522,7 @@ void gameUpdateAndRender(Context& ctx)
         ctx.timeScale += 1;
 
     float time = getElapsedTime();
-    for (auto& entity : ctx.entityManager.entities)
-    {
-        if (hasType(entity, EntityType::Drawable))
-            setShaderVariableFloat(*entity.drawCommand, "time", time);
-    }
+    setShaderTime(ctx.render, time);
 
     if (wasKeyPressed(KeyboardKey::KEY_R))
         ctx.wantsToReload = true;
@@ -534,10 +531,10 @@ void gameUpdateAndRender(Context& ctx)
 
     const auto speed = 75.f * dt;
     const auto sine = std::sin(time) * dt;
-    if (ctx.gameState.sphere)
+    if (const auto sphere = getEntity(ctx.gameState.sphere); sphere)
     {
-        addLocalRotation(*ctx.gameState.sphere, vec3(0, speed * 0.5, 0));
-        addLocalPosition(*ctx.gameState.sphere, vec3(0, sine, 0));
+        addLocalRotation(*sphere, vec3(0, speed * 0.5, 0));
+        addLocalPosition(*sphere, vec3(0, sine, 0));
     }
 
     if (ctx.render.needsToResize)
@@ -548,10 +545,23 @@ void gameUpdateAndRender(Context& ctx)
     guiBegin();
     onGui(ctx);
 
+    flushTransforms(ctx.entityManager);
+
     static vec4 clearColor{0, 0, 0, 1};
     renderClearAndResize(ctx.render, clearColor);
-    for (const auto& command : ctx.render.drawCommands)
-        renderDraw(command);
+    renderBeginFrame(ctx.render);
+    const auto drawList = renderBuildDrawList(ctx.render, ctx.tempMemory);
+    const auto drawBatches = renderBuildDrawBatches(drawList, ctx.tempMemory);
+    renderUploadInstances(drawBatches);
+    for (size_t i = 0; i < drawBatches.count; ++i)
+    {
+        const auto& batch = drawBatches.batches[i];
+        const auto& command = *drawList.commands[batch.first];
+        if (batch.instanced)
+            renderDrawInstanced(ctx.render, command, batch.firstInstance, batch.count);
+        else
+            renderDraw(ctx.render, command);
+    }
     guiDraw();
     renderPresent();
 
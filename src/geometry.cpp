@@ -1,4 +1,7 @@
 #include "geometry.hpp"
+#include "common/hash_map.hpp"
+
+#include <charconv>
 
 static Mesh generateSphere(float radius,
     u32 stacks,
@@ -291,179 +294,252 @@ Mesh generateMesh(GeneratedMesh type, Arena& tempMemory)
     return mesh;
 }
 
-Mesh loadMesh(Asset const& asset, Arena& permanentMemory, Arena& tempMemory)
+// obj parsing. fields are views into the asset, numbers go through from_chars instead of sscanf
+static constexpr u32 OBJ_MISSING_INDEX = ~0u;
+
+struct ObjCorner
 {
-    bool logVertices = false;
+    u32 pos;
+    u32 uv;
+    u32 normal;
+};
 
-    logInfo("loading \'%s\' mesh asset", asset.name.data);
+static bool objParseFloat(String field, float& out)
+{
+    auto begin = field.data;
+    const auto end = field.data + field.length;
+    if (begin != end && *begin == '+')
+        begin++;
+    const auto [ptr, error] = std::from_chars(begin, end, out);
+    return error == std::errc{} && ptr == end;
+}
 
-    // if (asset.name == "plane")
-    //     logVertices = true;
+static bool objParseFloats(StrFieldCursor& fields, float* out, size_t count)
+{
+    String field;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!strNextField(fields, field) || !objParseFloat(field, out[i]))
+            return false;
+    }
+    return true;
+}
 
-    ENSURE(asset.type == AssetType::ObjMesh);
+// 1-based, negative indices count back from the last element read so far. writes a 0-based index, or
+// OBJ_MISSING_INDEX for an empty one. false when the index is malformed or refers to no element
+static bool objResolveIndex(const char*& p, const char* end, size_t elementCount, u32& out)
+{
+    out = OBJ_MISSING_INDEX;
+    if (p == end || *p == '/')
+        return true;
+
+    i64 index = 0;
+    const auto [ptr, error] = std::from_chars(p, end, index);
+    if (error != std::errc{} || index == 0)
+        return false;
+    p = ptr;
+
+    const auto resolved = index < 0 ? (i64)elementCount + index : index - 1;
+    if (resolved < 0 || (size_t)resolved >= elementCount)
+        return false;
+    out = (u32)resolved;
+    return true;
+}
 
-    size_t posCount = 0;
-    size_t normalCount = 0;
-    size_t uvCount = 0;
-    size_t verticesCount = 0;
+// v, v/vt, v//vn or v/vt/vn
+static bool objParseCorner(String field, size_t posCount, size_t uvCount, size_t normalCount, ObjCorner& corner)
+{
+    corner = {.pos = OBJ_MISSING_INDEX, .uv = OBJ_MISSING_INDEX, .normal = OBJ_MISSING_INDEX};
 
-    const auto lines = strSplit(String{.data = (char*)asset.data, .length = asset.size}, STR_NEWL, tempMemory);
+    auto p = (const char*)field.data;
+    const auto end = p + field.length;
 
-    for (const auto& line : lines)
-    {
-        auto headerStart = strFindNot(line, STR_WHITESPACE, false);
-        if (!headerStart)
-            break;
+    if (!objResolveIndex(p, end, posCount, corner.pos) || corner.pos == OBJ_MISSING_INDEX)
+        return false;
 
-        auto header = strFindUntil(headerStart, STR_WHITESPACE, false);
-
-        auto isPosLine = header == "v";
-        auto isNormalLine = header == "vn";
-        auto isUVLine = header == "vt";
-        auto isIndexLine = header == "f";
-
-        if (isPosLine)
-            posCount++;
-        else if (isNormalLine)
-            normalCount++;
-        else if (isUVLine)
-            uvCount++;
-        else if (isIndexLine)
-            verticesCount++;
+    if (p != end && *p == '/')
+    {
+        p++;
+        if (!objResolveIndex(p, end, uvCount, corner.uv))
+            return false;
+    }
+    if (p != end && *p == '/')
+    {
+        p++;
+        if (!objResolveIndex(p, end, normalCount, corner.normal))
+            return false;
     }
 
-    auto posBuffer = arenaAlloc<vec3>(tempMemory, posCount);
-    auto normalBuffer = arenaAlloc<vec3>(tempMemory, normalCount);
-    auto uvBuffer = arenaAlloc<vec2>(tempMemory, uvCount);
+    return p == end;
+}
 
-    auto posIndicesBuffer = arenaAlloc<u32>(tempMemory, verticesCount * 3);
-    auto normalIndicesBuffer = arenaAlloc<u32>(tempMemory, verticesCount * 3);
-    auto uvIndicesBuffer = arenaAlloc<u32>(tempMemory, verticesCount * 3);
+Mesh loadMesh(Asset const& asset, Arena& permanentMemory, Arena& tempMemory)
+{
+    bool logVertices = false;
 
-    bool withoutUV = false;
+    logInfo("loading \'%s\' mesh asset", asset.name.data);
 
-    for (size_t lineIdx = 0, posIdx = 0, normalIdx = 0, uvIdx = 0, indexIdx = 0; lineIdx < lines.size; ++lineIdx)
-    {
-        auto line = lines[lineIdx];
+    // if (asset.name == "plane")
+    //     logVertices = true;
 
-        auto headerStart = strFindNot(line, STR_WHITESPACE, false);
-        if (!headerStart)
-            break;
+    ENSURE(asset.type == AssetType::ObjMesh);
 
-        auto header = strFindUntil(headerStart, STR_WHITESPACE, false);
+    // everything below except the vertices is released once the mesh is built
+    const auto temp = arenaTempBegin(tempMemory);
+    defer({ arenaTempEnd(temp); });
 
-        auto isPosLine = header == "v";
-        auto isNormalLine = header == "vn";
-        auto isUVLine = header == "vt";
-        auto isIndexLine = header == "f";
+    Array<vec3> positions{};
+    Array<vec3> normals{};
+    Array<vec2> uvs{};
+    Array<ObjCorner> corners{};  // three per triangle
 
-        if (isPosLine)
-        {
-            auto& vec = posBuffer[posIdx];
-            const auto matches = sscanf(header.data + header.length, "%f %f %f", &vec.x, &vec.y, &vec.z);
-            ENSURE(matches == 3);
+    const auto source = String{.data = (char*)asset.data, .length = asset.size};
 
-            if (logVertices)
-            {
-                logInfo("extracted %i pos: %f %f %f", normalIdx, vec[0], vec[1], vec[2]);
-            }
+    String line;
+    for (auto lines = strLines(source); strNextLine(lines, line);)
+    {
+        auto fields = strFields(line);
+
+        String header;
+        if (!strNextField(fields, header) || header[0] == '#')
+            continue;
 
-            posIdx++;
+        if (header == strL("v"))
+        {
+            vec3 pos;
+            ENSURE(objParseFloats(fields, &pos.x, 3));
+            arrayPush(positions, pos, tempMemory);
         }
-        else if (isNormalLine)
+        else if (header == strL("vn"))
         {
-            auto& vec = normalBuffer[normalIdx];
-            const auto matches = sscanf(header.data + header.length, "%f %f %f", &vec.x, &vec.y, &vec.z);
-            ENSURE(matches == 3);
-
-            if (logVertices)
-            {
-                logInfo("extracted %i normal: %f %f %f", normalIdx, vec[0], vec[1], vec[2]);
-            }
-
-            normalIdx++;
+            vec3 normal;
+            ENSURE(objParseFloats(fields, &normal.x, 3));
+            arrayPush(normals, normal, tempMemory);
         }
-        else if (isUVLine)
+        else if (header == strL("vt"))
         {
-            auto& vec = uvBuffer[uvIdx];
-            const auto matches = sscanf(header.data + header.length, "%f %f", &vec.x, &vec.y);
-            ENSURE(matches == 2);
-
-            if (logVertices)
-            {
-                logInfo("extracted %i uv: %f %f ", normalIdx, vec[0], vec[1]);
-            }
-
-            uvIdx++;
+            vec2 uv;
+            ENSURE(objParseFloats(fields, &uv.x, 2));
+            arrayPush(uvs, uv, tempMemory);
         }
-        else if (isIndexLine)
+        else if (header == strL("f"))
         {
-            u32 posIndices[3]{}, normalIndices[3]{}, uvIndices[3]{};
-            auto matches = sscanf(header.data + header.length,
-                "%u/%u/%u %u/%u/%u %u/%u/%u",
-                &posIndices[0],
-                &uvIndices[0],
-                &normalIndices[0],
-                &posIndices[1],
-                &uvIndices[1],
-                &normalIndices[1],
-                &posIndices[2],
-                &uvIndices[2],
-                &normalIndices[2]);
-            if (matches != 9)
+            // polygons are triangulated as a fan around their first corner
+            ObjCorner first{}, previous{};
+            size_t cornerCount = 0;
+            const auto faceStart = corners.size;
+            bool valid = true;
+
+            String field;
+            while (strNextField(fields, field))
+            {
+                ObjCorner corner;
+                if (!objParseCorner(field, positions.size, uvs.size, normals.size, corner))
+                {
+                    // the face's triangles so far are dropped with it, the rest of the mesh still loads
+                    logError("skipping face with invalid corner '%.*s' in mesh %s",
+                        (int)field.length,
+                        field.data,
+                        asset.name.data);
+                    valid = false;
+                    break;
+                }
+                if (cornerCount >= 2)
+                {
+                    arrayPush(corners, first, tempMemory);
+                    arrayPush(corners, previous, tempMemory);
+                    arrayPush(corners, corner, tempMemory);
+                }
+                else if (cornerCount == 0)
+                {
+                    first = corner;
+                }
+                previous = corner;
+                cornerCount++;
+            }
+            if (valid && cornerCount < 3)
             {
-                withoutUV = true;
-                // check export without uv
-                matches = sscanf(header.data + header.length,
-                    "%u//%u %u//%u %u//%u",
-                    &posIndices[0],
-                    &normalIndices[0],
-                    &posIndices[1],
-                    &normalIndices[1],
-                    &posIndices[2],
-                    &normalIndices[2]);
-                ENSURE(matches == 6);
+                logError("skipping face with %zu corners in mesh %s", cornerCount, asset.name.data);
+                valid = false;
             }
-            if (!withoutUV)
-                ENSURE(matches == 9);
-
-            posIndicesBuffer[indexIdx * 3 + 0] = posIndices[0];
-            posIndicesBuffer[indexIdx * 3 + 1] = posIndices[1];
-            posIndicesBuffer[indexIdx * 3 + 2] = posIndices[2];
-            uvIndicesBuffer[indexIdx * 3 + 0] = uvIndices[0];
-            uvIndicesBuffer[indexIdx * 3 + 1] = uvIndices[1];
-            uvIndicesBuffer[indexIdx * 3 + 2] = uvIndices[2];
-            normalIndicesBuffer[indexIdx * 3 + 0] = normalIndices[0];
-            normalIndicesBuffer[indexIdx * 3 + 1] = normalIndices[1];
-            normalIndicesBuffer[indexIdx * 3 + 2] = normalIndices[2];
-
-            indexIdx++;
+            if (!valid)
+                corners.size = faceStart;
         }
     }
 
-    verticesCount *= 3;
+    if (corners.size == 0)
+    {
+        logError("mesh %s has no faces", asset.name.data);
+        Mesh mesh{};
+        mesh.name = asset.name;
+        return mesh;
+    }
+
+    // corners sharing the same pos/uv/normal triple become one vertex
+    const auto indicesCount = corners.size;
+    auto indices = arenaAlloc<u32>(permanentMemory, indicesCount);
 
-    auto vertices = arenaAlloc<Vertex>(permanentMemory, verticesCount);
+    Array<Vertex> uniqueVertices{};
+    HashMap<ObjCorner, u32> vertexIds{};
+    mapAlloc(vertexIds, indicesCount / 4, &tempMemory);
 
-    for (size_t i = 0; i < verticesCount; ++i)
+    bool hasMissingNormals = false;
+    for (size_t i = 0; i < indicesCount; ++i)
     {
-        const auto posIdx = posIndicesBuffer[i];
-        vertices[i].pos = posBuffer[posIdx - 1];
-        const auto normalIdx = normalIndicesBuffer[i];
-        vertices[i].normal = normalBuffer[normalIdx - 1];
-        if (!withoutUV)
+        const auto& corner = corners[i];
+        if (const auto id = mapAt(vertexIds, corner))
         {
-            const auto uvIdx = uvIndicesBuffer[i];
-            vertices[i].uv = uvBuffer[uvIdx - 1];
+            indices[i] = *id;
+            continue;
         }
+
+        Vertex vertex{};
+        vertex.pos = positions[corner.pos];
+        if (corner.normal != OBJ_MISSING_INDEX)
+            vertex.normal = normals[corner.normal];
+        else
+            hasMissingNormals = true;
+        if (corner.uv != OBJ_MISSING_INDEX)
+            vertex.uv = uvs[corner.uv];
+
+        indices[i] = (u32)uniqueVertices.size;
+        mapInsert(vertexIds, corner, indices[i]);
+        arrayPush(uniqueVertices, vertex, tempMemory);
     }
 
-    logInfo("loaded \'%s\' mesh asset, vertices: %i", asset.name.data, verticesCount);
+    // vertices without a normal get the area weighted average of their triangles' normals
+    if (hasMissingNormals)
+    {
+        for (size_t i = 0; i < indicesCount; i += 3)
+        {
+            auto& a = uniqueVertices[indices[i]];
+            auto& b = uniqueVertices[indices[i + 1]];
+            auto& c = uniqueVertices[indices[i + 2]];
+            const auto faceNormal = cross(b.pos - a.pos, c.pos - a.pos);
+            for (size_t j = i; j < i + 3; ++j)
+            {
+                if (corners[j].normal == OBJ_MISSING_INDEX)
+                    uniqueVertices[indices[j]].normal += faceNormal;
+            }
+        }
+
+        for (size_t i = 0; i < indicesCount; ++i)
+        {
+            if (corners[i].normal == OBJ_MISSING_INDEX)
+                uniqueVertices[indices[i]].normal = normalize(uniqueVertices[indices[i]].normal);
+        }
+    }
+
+    const auto verticesCount = uniqueVertices.size;
+    auto vertices = arenaAlloc<Vertex>(permanentMemory, verticesCount);
+    memcpy(vertices, uniqueVertices.data, verticesCount * sizeof(Vertex));
+
+    logInfo("loaded \'%s\' mesh asset, vertices: %zu, indices: %zu", asset.name.data, verticesCount, indicesCount);
 
     if (logVertices)
         for (size_t i = 0; i < verticesCount; ++i)
         {
-            logInfo("mesh vertex %i: pos: %s, normal: %s, uv: %s",
+            logInfo("mesh vertex %zu: pos: %s, normal: %s, uv: %s",
                 i,
                 vec3ToString(tempMemory, vertices[i].pos),
                 vec3ToString(tempMemory, vertices[i].normal),
@@ -474,6 +550,9 @@ Mesh loadMesh(Asset const& asset, Arena& permanentMemory, Arena& tempMemory)
 
     mesh.vertices = vertices;
     mesh.verticesCount = verticesCount;
+    mesh.indices = indices;
+    mesh.indicesCount = indicesCount;
+    mesh.flags |= MeshFlag::Indexed;
     mesh.name = asset.name;
 
     return mesh;
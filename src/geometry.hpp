@@ -39,6 +39,10 @@ struct Mesh
     MeshFlag flags;
     size_t id;
     String name;
+
+    // where renderUploadMesh placed the mesh in the shared vertex and index buffers
+    u32 baseVertex;
+    u32 firstIndex;
 };
 
 Mesh generateMesh(GeneratedMesh type, Arena& tempMemory);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "platform.hpp"
+#include "entity.hpp"
 
 void guiInit(void** outWindowEventCallback, void* window, float dpi);
 void guiBegin();
@@ -11,5 +12,5 @@ bool guiIsCapturingKeyboard();
 
 struct GuiState
 {
-    void* selectedEntity;
+    EntityHandle selectedEntity;
 };
@@ -84,14 +84,17 @@ void loadAssetsByType(AssetType type, String name = {})
             arrayPush(assets, Platform::loadAsset(filePath, assetLoadType, g_context->platformMemory, g_context->tempMemory));
 
             if (toRename)
+            {
                 arrayLast(assets)->name = toRename;
+                arrayLast(assets)->id = assetId(toRename);
+            }
         });
 }
 
 int main()
 {
     Context context{};
-    contextInit(context, Megabytes(100), Megabytes(25));
+    contextInit(context, Gigabytes(8ull), Gigabytes(1ull));
     defer({ contextDeinit(context); });
 
     g_context = &context;
@@ -148,6 +151,7 @@ int main()
         game.updateAndRender(context);
 
         arenaClear(context.tempMemory);
+        ENSURE(context.scratchMemory.used == 0);
     }
 
     game.exit(context);
@@ -19,23 +19,6 @@
             assert(false);                                                        \
         }                                                                         \
     } while (0)
-
-#define LOGIC_ERROR()             \
-    do                            \
-    {                             \
-        logError("logic error!"); \
-        assert(false);            \
-    } while (0)
-
-#define ENSURE(x)                          \
-    do                                     \
-    {                                      \
-        if (!(x))                          \
-        {                                  \
-            logError("ensure failed:" #x); \
-            assert(false);                 \
-        }                                  \
-    } while (0)
 #endif
 
 static constexpr const char* ASSETS_PATH[] = {
@@ -44,6 +27,16 @@ static constexpr const char* ASSETS_PATH[] = {
     "resources/textures/cubemaps",
 };
 
+// asset names are interned as their content hash, literals are resolved at compile time with ASSET_ID
+using AssetId = u64;
+
+constexpr AssetId assetId(String name)
+{
+    return strHash(name);
+}
+
+#define ASSET_ID(str) std::integral_constant<AssetId, assetId(strL(str))>::value
+
 enum class AssetType
 {
     ObjMesh,
@@ -56,6 +49,7 @@ struct Asset
 {
     const u8* data;
     String name;
+    AssetId id;
     size_t size;
     AssetType type;
     u32 textureWidth;
@@ -83,7 +77,11 @@ void closeWindow(Window window);
 void pollEvents();
 
 void* allocMemory(size_t size, void* startAddr = nullptr);
+void* reserveMemory(size_t size, void* startAddr = nullptr);
+bool commitMemory(void* addr, size_t size);
+void decommitMemory(void* addr, size_t size);
 void freeMemory(void* addr, size_t size);
+size_t getPageSize();
 
 void getExeDirectory(char* path);
 u64 getFileLastWrittenTime(const char* fileName);
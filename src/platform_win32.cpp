@@ -416,11 +416,33 @@ void* allocMemory(size_t size, void* startAddr)
     return VirtualAlloc(startAddr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 }
 
+void* reserveMemory(size_t size, void* startAddr)
+{
+    return VirtualAlloc(startAddr, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool commitMemory(void* addr, size_t size)
+{
+    return VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+void decommitMemory(void* addr, size_t size)
+{
+    VirtualFree(addr, size, MEM_DECOMMIT);
+}
+
 void freeMemory(void* addr, size_t size)
 {
     VirtualFree(addr, 0, MEM_RELEASE);
 }
 
+size_t getPageSize()
+{
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
 void getExeDirectory(char* outDirectory)
 {
     char exePath[MAX_PATH]{};
@@ -483,6 +505,9 @@ void* loadDynamicFunc(void* lib, const char* funcName)
 
 static String cloneNameFromPath(const char* path, Arena& cloneMemory, Arena& tempMemory)
 {
+    const auto temp = arenaTempBegin(tempMemory);
+    defer({ arenaTempEnd(temp); });
+
     const auto sPath = strClone(path, tempMemory);
 
     const auto nameWithExt = strFindReverse(sPath, strL("\\"), false, 1);
@@ -526,6 +551,7 @@ Asset loadAsset(const char* path, AssetType type, Arena& permanentMemory, Arena&
 
             asset.data = (u8*)buffer;
             asset.name = cloneNameFromPath(path, permanentMemory, tempMemory);
+            asset.id = assetId(asset.name);
             asset.size = fileSize;
             asset.type = type;
 
@@ -540,6 +566,7 @@ Asset loadAsset(const char* path, AssetType type, Arena& permanentMemory, Arena&
 
             asset.data = buffer;
             asset.name = cloneNameFromPath(path, permanentMemory, tempMemory);
+            asset.id = assetId(asset.name);
             asset.size = fileSize;
             asset.type = type;
 
@@ -0,0 +1,303 @@
+#include "renderer.hpp"
+
+// bits of a draw sort key, most significant first. commands are submitted in ascending key order, so everything
+// above the depth bits groups draws that can share bound state
+static constexpr u32 SORT_KEY_DEPTH_BITS = 23;
+static constexpr u32 SORT_KEY_MESH_BITS = 16;
+static constexpr u32 SORT_KEY_TEXTURES_BITS = 16;
+static constexpr u32 SORT_KEY_DEPTH_WRITE_BITS = 1;
+static constexpr u32 SORT_KEY_RASTERIZER_BITS = 2;
+static constexpr u32 SORT_KEY_SHADER_BITS = 4;
+static constexpr u32 SORT_KEY_PASS_BITS = 2;
+
+static constexpr u32 SORT_KEY_MESH_SHIFT = SORT_KEY_DEPTH_BITS;
+static constexpr u32 SORT_KEY_TEXTURES_SHIFT = SORT_KEY_MESH_SHIFT + SORT_KEY_MESH_BITS;
+static constexpr u32 SORT_KEY_DEPTH_WRITE_SHIFT = SORT_KEY_TEXTURES_SHIFT + SORT_KEY_TEXTURES_BITS;
+static constexpr u32 SORT_KEY_RASTERIZER_SHIFT = SORT_KEY_DEPTH_WRITE_SHIFT + SORT_KEY_DEPTH_WRITE_BITS;
+static constexpr u32 SORT_KEY_SHADER_SHIFT = SORT_KEY_RASTERIZER_SHIFT + SORT_KEY_RASTERIZER_BITS;
+static constexpr u32 SORT_KEY_PASS_SHIFT = SORT_KEY_SHADER_SHIFT + SORT_KEY_SHADER_BITS;
+
+static_assert(SORT_KEY_PASS_SHIFT + SORT_KEY_PASS_BITS == 64, "Sort key fields must fill 64 bits");
+static_assert((u32)RenderPass::Max <= 1u << SORT_KEY_PASS_BITS);
+static_assert((u32)ShaderType::Max <= 1u << SORT_KEY_SHADER_BITS);
+static_assert((u32)RasterizerState::Max <= 1u << SORT_KEY_RASTERIZER_BITS);
+
+static RenderPass getRenderPass(DrawCommand const& command)
+{
+    if (command.shader == ShaderType::Skybox)
+        return RenderPass::Skybox;
+    if (!bool(command.flags & DrawFlag::DepthWrite))
+        return RenderPass::NoDepthWrite;
+    return RenderPass::Opaque;
+}
+
+static u64 getDepthSortBits(float depth, bool backToFront)
+{
+    // a non-negative float orders the same as its bit pattern, the top bits keep the exponent and some mantissa
+    u32 bits;
+    depth = std::max(depth, 0.f);
+    memcpy(&bits, &depth, sizeof(bits));
+    u64 key = bits >> (32 - SORT_KEY_DEPTH_BITS);
+    if (backToFront)
+        key = ~key & ((1ull << SORT_KEY_DEPTH_BITS) - 1);
+    return key;
+}
+
+u64 getDrawSortKey(DrawCommand const& command)
+{
+    const auto pass = getRenderPass(command);
+
+    // generated and loaded meshes have overlapping ids
+    const u64 mesh = ((u64) !bool(command.mesh->flags & MeshFlag::Generated) << (SORT_KEY_MESH_BITS - 1)) |
+                     (command.mesh->id & ((1ull << (SORT_KEY_MESH_BITS - 1)) - 1));
+    const u64 textures = hashBytes(command.textures, sizeof(command.textures)) >> (64 - SORT_KEY_TEXTURES_BITS);
+
+    return (u64)pass << SORT_KEY_PASS_SHIFT | (u64)command.shader << SORT_KEY_SHADER_SHIFT |
+           (u64)command.rasterizerState << SORT_KEY_RASTERIZER_SHIFT |
+           (u64) !bool(command.flags & DrawFlag::DepthWrite) << SORT_KEY_DEPTH_WRITE_SHIFT |
+           textures << SORT_KEY_TEXTURES_SHIFT | mesh << SORT_KEY_MESH_SHIFT |
+           getDepthSortBits(command.depth, pass == RenderPass::NoDepthWrite);
+}
+
+// lsd radix sort on 8 bit digits, stable. digits that are the same for every key are skipped, which is most of
+// them when a scene has few shaders and meshes. keys and values live in `output`, the temporaries go elsewhere
+static void radixSort(u64* keys, DrawCommand const** values, size_t count, Arena const& output)
+{
+    const auto scratch = arenaScratchBegin(&output);
+    defer({ arenaTempEnd(scratch); });
+    auto& memory = *scratch.arena;
+
+    auto tempKeys = arenaAlloc<u64>(memory, count + 1);
+    auto tempValues = arenaAlloc<DrawCommand const*>(memory, count + 1);
+
+    size_t counts[8][256] = {};
+    for (size_t i = 0; i < count; ++i)
+        for (u32 digit = 0; digit < 8; ++digit)
+            counts[digit][(keys[i] >> (digit * 8)) & 0xFF]++;
+
+    auto srcKeys = keys, dstKeys = tempKeys;
+    auto srcValues = values, dstValues = tempValues;
+    for (u32 digit = 0; digit < 8; ++digit)
+    {
+        auto& digitCounts = counts[digit];
+        if (digitCounts[(keys[0] >> (digit * 8)) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (auto& digitCount : digitCounts)
+        {
+            const auto bucketSize = digitCount;
+            digitCount = offset;
+            offset += bucketSize;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto index = digitCounts[(srcKeys[i] >> (digit * 8)) & 0xFF]++;
+            dstKeys[index] = srcKeys[i];
+            dstValues[index] = srcValues[i];
+        }
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys)
+    {
+        memcpy(keys, srcKeys, count * sizeof(u64));
+        memcpy(values, srcValues, count * sizeof(DrawCommand const*));
+    }
+}
+
+DrawList renderBuildDrawList(RenderState& state, Arena& memory)
+{
+    const auto capacity = state.drawCommands.size;
+    DrawList list = {
+        .keys = arenaAlloc<u64>(memory, capacity + 1),
+        .commands = arenaAlloc<DrawCommand const*>(memory, capacity + 1),
+        .count = 0,
+    };
+
+    for (const auto& command : state.drawCommands)
+    {
+        if (!bool(command.flags & DrawFlag::Active))
+            continue;
+
+        ENSURE(command.mesh != nullptr);
+        list.keys[list.count] = getDrawSortKey(command);
+        list.commands[list.count] = &command;
+        list.count++;
+    }
+
+    if (list.count > 1)
+        radixSort(list.keys, list.commands, list.count, memory);
+
+    return list;
+}
+
+// copies the variables of commands that changed into their blocks and marks those blocks for upload
+void renderPackObjectVariables(RenderState& state)
+{
+    for (auto& command : state.drawCommands)
+    {
+        if (!command.variablesDirty)
+            continue;
+        command.variablesDirty = false;
+
+        const auto block = command.variablesBlock;
+        memcpy(state.objectVariables + (size_t)block * Shaders::OBJECT_VARIABLES_BLOCK_SIZE,
+            &command.variables,
+            sizeof(command.variables));
+        state.objectVariablesDirty[block / 64] |= 1ull << (block % 64);
+    }
+}
+
+ObjectVariablesRuns renderGetDirtyObjectVariables(RenderState const& state, Arena& memory)
+{
+    // every run but the last is followed by more clean blocks than a gap bridges
+    const auto capacity = (u32)state.drawCommands.capacity;
+    ObjectVariablesRuns result = {
+        .runs = arenaAlloc<ObjectVariablesRun>(memory, capacity / (OBJECT_VARIABLES_RUN_GAP + 2) + 1),
+        .count = 0,
+    };
+
+    for (u32 block = 0; block < capacity;)
+    {
+        const auto word = state.objectVariablesDirty[block / 64] >> (block % 64);
+        if (word == 0)
+        {
+            block = (block / 64 + 1) * 64;
+            continue;
+        }
+        if (!(word & 1))
+        {
+            block++;
+            continue;
+        }
+
+        if (result.count > 0 && block - result.runs[result.count - 1].end <= OBJECT_VARIABLES_RUN_GAP)
+            result.runs[result.count - 1].end = block + 1;
+        else
+            result.runs[result.count++] = {.begin = block, .end = block + 1};
+        block++;
+    }
+
+    return result;
+}
+
+void renderObjectVariablesUploaded(RenderState& state)
+{
+    memset(state.objectVariablesDirty, 0, renderObjectVariablesDirtyWords(state) * sizeof(u64));
+}
+
+// the sort key only holds a hash of the texture set, so neighbours are compared field by field
+static bool canInstanceTogether(DrawCommand const& a, DrawCommand const& b)
+{
+    return a.mesh == b.mesh && a.shader == b.shader && a.rasterizerState == b.rasterizerState &&
+           (a.flags & DrawFlag::DepthWrite) == (b.flags & DrawFlag::DepthWrite) &&
+           memcmp(a.textures, b.textures, sizeof(a.textures)) == 0;
+}
+
+DrawBatches renderBuildDrawBatches(DrawList const& list, Arena& memory)
+{
+    DrawBatches result = {
+        .batches = arenaAlloc<DrawBatch>(memory, list.count + 1),
+        .count = 0,
+        .instances = arenaAlloc<Shaders::InstanceVariables>(memory, std::min<size_t>(list.count, MAX_INSTANCES) + 1),
+        .instancesCount = 0,
+    };
+
+    for (u32 first = 0, end = 0; first < list.count;)
+    {
+        const auto& command = *list.commands[first];
+        // what is left of a run cut short by the instance buffer keeps its end
+        if (first >= end)
+        {
+            end = first + 1;
+            // the skybox reads no per-object variables
+            if (command.shader != ShaderType::Skybox)
+                while (end < list.count && canInstanceTogether(command, *list.commands[end]))
+                    end++;
+        }
+
+        // a run takes as much of the instance buffer as is left and the rest of it carries into the next batch
+        auto count = std::min(end - first, (u32)(MAX_INSTANCES - result.instancesCount));
+        const auto instanced = count >= MIN_INSTANCED_DRAWS;
+        if (!instanced)
+            count = 1;
+
+        auto& batch = result.batches[result.count++];
+        batch = {.first = first, .count = count, .firstInstance = (u32)result.instancesCount, .instanced = instanced};
+
+        if (instanced)
+        {
+            for (u32 i = first; i < first + count; ++i)
+            {
+                const auto& variables = list.commands[i]->variables;
+                auto& instance = result.instances[result.instancesCount++];
+                memcpy(instance.world, variables.world, sizeof(instance.world));
+                memcpy(instance.objectColor, variables.objectColor, sizeof(instance.objectColor));
+            }
+        }
+
+        first += count;
+    }
+
+    return result;
+}
+
+static u64 packPipelineStateDesc(PipelineStateDesc const& desc)
+{
+    return (u64)desc.shader << 24 | (u64)desc.rasterizerState << 16 | (u64)desc.depthWrite << 8 | (u64)desc.instanced;
+}
+
+u32 getPipelineState(RenderState& state, DrawCommand const& command, bool instanced)
+{
+    const PipelineStateDesc desc = {
+        .shader = command.shader,
+        .rasterizerState = command.rasterizerState,
+        .depthWrite = bool(command.flags & DrawFlag::DepthWrite),
+        .instanced = instanced,
+    };
+    const auto key = packPipelineStateDesc(desc);
+    if (const auto index = mapAt(state.pipelineStateIds, key))
+        return *index;
+
+    ENSURE(state.pipelineStatesCount < MAX_PIPELINE_STATES);
+    const auto index = state.pipelineStatesCount++;
+    state.pipelineStates[index] = desc;
+    mapInsert(state.pipelineStateIds, key, index);
+    return index;
+}
+
+void invalidateBoundDrawState(RenderState& state)
+{
+    state.boundState.valid = false;
+}
+
+DrawStateChanges trackDrawState(RenderState& state, DrawCommand const& command, bool instanced)
+{
+    auto& bound = state.boundState;
+    const auto pipelineState = getPipelineState(state, command, instanced);
+
+    DrawStateChanges result = {
+        .changes = DrawStateChange::None,
+        .previousPipelineState = bound.valid ? bound.pipelineState : NO_PIPELINE_STATE,
+        .pipelineState = pipelineState,
+        .textureSlots = 0,
+    };
+
+    if (!bound.valid || bound.pipelineState != pipelineState)
+        result.changes |= DrawStateChange::PipelineState;
+    for (u32 i = 0; i < MAX_TEXTURE_SLOTS; ++i)
+        if (!bound.valid || bound.textures[i] != command.textures[i])
+            result.textureSlots |= 1u << i;
+    if (result.textureSlots)
+        result.changes |= DrawStateChange::Textures;
+
+    bound.pipelineState = pipelineState;
+    memcpy(bound.textures, command.textures, sizeof(bound.textures));
+    bound.valid = true;
+
+    return result;
+}
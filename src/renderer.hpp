@@ -3,6 +3,9 @@
 #include "geometry.hpp"
 #include "texture.hpp"
 #include "common/array.hpp"
+#include "common/slot_map.hpp"
+#include "common/hash_map.hpp"
+#include "common/range_allocator.hpp"
 
 #include "shaders.hpp"
 
@@ -21,6 +24,15 @@ enum class DrawFlag
 
 DEFINE_ENUM_BITWISE_OPERATORS(DrawFlag);
 
+// submission order, the most significant field of a draw's sort key
+enum class RenderPass
+{
+    Opaque,
+    Skybox,
+    NoDepthWrite,
+    Max
+};
+
 static constexpr auto MAX_TEXTURE_SLOTS = 5;
 struct DrawCommand
 {
@@ -28,77 +40,259 @@ struct DrawCommand
     RasterizerState rasterizerState;
     Mesh* mesh;
     ShaderType shader;
-    ShaderVariable variables[MAX_SHADER_VARIABLES];
+    Shaders::ObjectVariables variables;  // image of the object constant buffer, uploaded as is
+    u32 variablesBlock;                  // the command's block of RenderState::objectVariables, its slot index
+    bool variablesDirty;
     Texture* textures[MAX_TEXTURE_SLOTS];
+    float depth;  // view space depth of the origin, updated along with the mvp
+};
+
+// shader, rasterizer and depth state of a draw. each distinct one is baked by the backend into a single object,
+// looked up by its packed key
+struct PipelineStateDesc
+{
+    ShaderType shader;
+    RasterizerState rasterizerState;
+    bool depthWrite;
+    bool instanced;
+};
+
+static constexpr auto MAX_PIPELINE_STATES = 32;
+
+// sizes of the shared mesh buffers in vertices and indices, and how fragmented they may get
+static constexpr u32 MAX_MESH_VERTICES = 1 << 20;
+static constexpr u32 MAX_MESH_INDICES = 1 << 22;
+static constexpr u32 MAX_MESH_RANGES = 1024;
+static constexpr u32 NO_PIPELINE_STATE = ~0u;
+
+// what the backend has bound, draws only issue api calls for the parts that differ from it.
+// anything else touching the pipeline (gui, clears, resizes) has to invalidate it
+struct BoundDrawState
+{
+    u32 pipelineState;
+    Texture const* textures[MAX_TEXTURE_SLOTS];
+    bool valid;
+};
+
+enum class DrawStateChange
+{
+    None = 0,
+    PipelineState = BIT(0),
+    Textures = BIT(1),
+};
+
+DEFINE_ENUM_BITWISE_OPERATORS(DrawStateChange);
+
+struct DrawStateChanges
+{
+    DrawStateChange changes;
+    u32 previousPipelineState;  // NO_PIPELINE_STATE when nothing known is bound
+    u32 pipelineState;
+    u32 textureSlots;  // a bit per texture slot to rebind
+};
+
+// active commands of a frame ordered by their sort keys
+struct DrawList
+{
+    u64* keys;
+    DrawCommand const** commands;
+    size_t count;
+};
+
+static constexpr auto MAX_INSTANCES = 65536;
+static constexpr auto MIN_INSTANCED_DRAWS = 2;
+
+// a run of the draw list with the same mesh, shader, state and textures. runs of at least MIN_INSTANCED_DRAWS go
+// out as one instanced draw of the first command, reading the others' variables from the instance buffer. a run
+// that doesn't fit in what's left of the buffer is split, the part that doesn't fit carries into the next batch
+struct DrawBatch
+{
+    u32 first;  // index into the draw list
+    u32 count;
+    u32 firstInstance;  // into DrawBatches::instances, only for instanced batches
+    bool instanced;
+};
+
+struct DrawBatches
+{
+    DrawBatch* batches;
+    size_t count;
+    Shaders::InstanceVariables* instances;
+    size_t instancesCount;
+};
+
+// blocks [begin, end) of RenderState::objectVariables that go up in one copy. dirty blocks at most
+// OBJECT_VARIABLES_RUN_GAP apart share a run, a few clean blocks cost less to copy than another update call
+struct ObjectVariablesRun
+{
+    u32 begin;
+    u32 end;
+};
+
+struct ObjectVariablesRuns
+{
+    ObjectVariablesRun* runs;
+    size_t count;
 };
 
+static constexpr u32 OBJECT_VARIABLES_RUN_GAP = 4;
+
 struct RenderState
 {
     bool needsToResize;
     vec2 screenSize;
 
-    Array<DrawCommand> drawCommands;
+    SlotMap<DrawCommand> drawCommands;
+
+    // shared by every draw, renderBeginFrame uploads them when they changed
+    Shaders::FrameVariables frameVariables;
+    Shaders::LightVariables lightVariables;
+    bool frameVariablesDirty;
+    bool lightVariablesDirty;
+
+    // object variables of every draw command by block, mirrored on the gpu. a bit per block marks the ones that
+    // changed since the last upload
+    u8* objectVariables;
+    u64* objectVariablesDirty;
+
+    PipelineStateDesc pipelineStates[MAX_PIPELINE_STATES];
+    u32 pipelineStatesCount;
+    HashMap<u64, u32> pipelineStateIds;  // packed desc -> index into pipelineStates
+    BoundDrawState boundState;
+
+    // all meshes share one vertex and one index buffer, these hand out their ranges
+    RangeAllocator meshVertices;
+    RangeAllocator meshIndices;
 
     Mesh generatedMeshes[(i32)GeneratedMesh::Max];
     Array<Mesh> meshes;
+    HashMap<AssetId, u32> meshIds;  // asset id -> index into meshes
 
     Array<Texture> allTextures;
     Array<Texture> spMeshTextures;
     Array<Texture> spCubemaps;
+    HashMap<AssetId, u32> textureIds;  // asset id -> index into spMeshTextures
+    HashMap<AssetId, u32> cubemapIds;  // asset id -> index of the first face in spCubemaps
 };
 
-inline Mesh& renderGetMesh(RenderState& state, String name)
+TRIVIAL_TEMPLATE_T(T)
+T& renderGetAsset(Array<T>& table, HashMap<AssetId, u32>& ids, AssetId id, const char* kind, String name = {})
 {
-    const auto result = find(state.meshes.data, state.meshes.size, [name](Mesh& mesh) { return mesh.name == name; });
-    if (!result)
+    const auto index = mapAt(ids, id);
+    if (!index)
     {
-        logError("%.*s mesh not found", name.length, name.data);
-        ENSURE(result);
+        logError("%.*s %s not found (id 0x%llx)", name.length, name.data, kind, id);
+        ENSURE(index);
     }
-    return *result;
+    return table[*index];
+}
+
+inline Mesh& renderGetMesh(RenderState& state, AssetId id)
+{
+    return renderGetAsset(state.meshes, state.meshIds, id, "mesh");
+}
+
+inline Mesh& renderGetMesh(RenderState& state, String name)
+{
+    return renderGetAsset(state.meshes, state.meshIds, assetId(name), "mesh", name);
+}
+
+inline Texture& renderGetTexture(RenderState& state, AssetId id)
+{
+    return renderGetAsset(state.spMeshTextures, state.textureIds, id, "texture");
 }
 
 inline Texture& renderGetTexture(RenderState& state, String name)
 {
-    const auto result =
-        find(state.spMeshTextures.data, state.spMeshTextures.size, [name](Texture& texture) { return texture.name == name; });
-    if (!result)
-    {
-        logError("%.*s texture not found", name.length, name.data);
-        ENSURE(result);
-    }
-    return *result;
+    return renderGetAsset(state.spMeshTextures, state.textureIds, assetId(name), "texture", name);
+}
+
+inline Texture& renderGetCubemap(RenderState& state, AssetId id)
+{
+    return renderGetAsset(state.spCubemaps, state.cubemapIds, id, "cubemap texture");
 }
 
 inline Texture& renderGetCubemap(RenderState& state, String name)
 {
-    const auto result =
-        find(state.spCubemaps.data, state.spCubemaps.size, [name](Texture& texture) { return texture.name == name; });
-    if (!result)
-    {
-        logError("%.*s cubemap texture not found", name.length, name.data);
-        ENSURE(result);
-    }
-    return *result;
+    return renderGetAsset(state.spCubemaps, state.cubemapIds, assetId(name), "cubemap texture", name);
 }
 
 void renderInitResources(RenderState& state, Array<Asset> const& assets);
 void renderInit(RenderState& state, void* window);
 void renderDeinit();
 
-void createShaderVariables(DrawCommand& command);
+// places the mesh in the shared buffers, fails when they have no room left for it
+bool renderUploadMesh(RenderState& state, Mesh& mesh);
+void renderFreeMesh(RenderState& state, Mesh& mesh);
 
-inline DrawCommand* pushDrawCmd(RenderState& state, Mesh& mesh, ShaderType shader = ShaderType::Basic)
+template <typename T>
+void setShaderVariable(DrawCommand& command, ShaderVariableSlot<T> slot, T const& value)
+{
+    memcpy((u8*)&command.variables + slot.offsetBytes, &value, sizeof(T));
+    command.variablesDirty = true;
+}
+
+template <typename T>
+T getShaderVariable(DrawCommand const& command, ShaderVariableSlot<T> slot)
+{
+    T value;
+    memcpy(&value, (const u8*)&command.variables + slot.offsetBytes, sizeof(T));
+    return value;
+}
+
+inline Handle<DrawCommand> pushDrawCmd(RenderState& state, Mesh& mesh, ShaderType shader = ShaderType::Basic)
 {
     DrawCommand cmd = {};
     cmd.flags = DrawFlag::Active | DrawFlag::DepthWrite;
     cmd.rasterizerState = RasterizerState::Default;
     cmd.shader = shader;
     cmd.mesh = &mesh;
-    createShaderVariables(cmd);
-    return arrayPush(state.drawCommands, cmd);
+    cmd.variables = Shaders::DEFAULT_OBJECT_VARIABLES;
+    cmd.variablesDirty = true;
+    const auto handle = slotMapInsert(state.drawCommands, cmd);
+    slotMapGet(state.drawCommands, handle)->variablesBlock = handleIndex(handle);
+    return handle;
+}
+
+inline void freeDrawCmd(RenderState& state, Handle<DrawCommand> handle)
+{
+    slotMapErase(state.drawCommands, handle);
+}
+
+inline size_t renderObjectVariablesDirtyWords(RenderState const& state)
+{
+    return (state.drawCommands.capacity + 63) / 64;
+}
+
+// a block per draw command slot, none of them dirty
+inline void renderAllocObjectVariables(RenderState& state, Arena& memory)
+{
+    state.objectVariables = arenaAlloc<u8>(memory, state.drawCommands.capacity * Shaders::OBJECT_VARIABLES_BLOCK_SIZE);
+    state.objectVariablesDirty = arenaAlloc<u64>(memory, renderObjectVariablesDirtyWords(state));
+    memset(state.objectVariablesDirty, 0, renderObjectVariablesDirtyWords(state) * sizeof(u64));
 }
 
+// every block goes up with the next upload, for a freshly created gpu copy
+inline void renderMarkObjectVariablesDirty(RenderState& state)
+{
+    memset(state.objectVariablesDirty, 0xFF, renderObjectVariablesDirtyWords(state) * sizeof(u64));
+}
+
+u64 getDrawSortKey(DrawCommand const& command);
+DrawList renderBuildDrawList(RenderState& state, Arena& memory);
+DrawBatches renderBuildDrawBatches(DrawList const& list, Arena& memory);
+void renderPackObjectVariables(RenderState& state);
+ObjectVariablesRuns renderGetDirtyObjectVariables(RenderState const& state, Arena& memory);
+// clears the dirty blocks once the backend has copied them to the gpu
+void renderObjectVariablesUploaded(RenderState& state);
+
+u32 getPipelineState(RenderState& state, DrawCommand const& command, bool instanced = false);
+void invalidateBoundDrawState(RenderState& state);
+DrawStateChanges trackDrawState(RenderState& state, DrawCommand const& command, bool instanced = false);
+
 void renderClearAndResize(RenderState& state, glm::vec4 color);
-void renderDraw(DrawCommand const& command);
+void renderBeginFrame(RenderState& state);
+void renderDraw(RenderState& state, DrawCommand const& command);
+void renderUploadInstances(DrawBatches const& batches);
+void renderDrawInstanced(RenderState& state, DrawCommand const& command, u32 firstInstance, u32 instanceCount);
 void renderPresent();
@@ -3,6 +3,7 @@
 #include "context.hpp"
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcommon.h>
 #include <d3dcompiler.h>
 
@@ -13,63 +14,58 @@ using namespace Microsoft::WRL;
 static ComPtr<ID3D11Device> s_device;
 static ComPtr<IDXGISwapChain> s_swapChain;
 static ComPtr<ID3D11DeviceContext> s_deviceContext;
+static ComPtr<ID3D11DeviceContext1> s_deviceContext1;  // null without constant buffer offsetting
+static bool s_constantBufferPartialUpdate;
 static ComPtr<ID3D11RenderTargetView> s_rtView;
 static ComPtr<ID3D11DepthStencilView> s_dsView;
 static ID3D11DepthStencilState* s_depthStencilDefault;
 static ID3D11DepthStencilState* s_depthStencilNoWrite;
 
-static Array<ID3D11Buffer*> s_vertexBuffers;
-static Array<ID3D11Buffer*> s_indexBuffers;
+// every mesh lives in a range of these, RenderState::meshVertices and meshIndices track which ranges are taken
+static ComPtr<ID3D11Buffer> s_meshVertexBuffer;
+static ComPtr<ID3D11Buffer> s_meshIndexBuffer;
 
 static Array<ID3D11ShaderResourceView*> s_textureViews;
 static ID3D11SamplerState* s_textureSampler;
 static ID3D11SamplerState* s_cubeMapTextureSampler;
 
-size_t getMeshBufferIndex(Mesh const& mesh)
-{
-    return !size_t(mesh.flags & MeshFlag::Generated) * (size_t)GeneratedMesh::Max + mesh.id;
-}
-
-struct ConstantBufferFieldMapping
-{
-    const char* name;
-    size_t offsetBytes;
-    size_t sizeBytes;
-    ShaderVariableValue defaultValue;
-};
-
-struct ConstantBuffer
-{
-    ComPtr<ID3D11Buffer> buffer;
-    ConstantBufferFieldMapping mappings[MAX_SHADER_VARIABLES];
-};
-
-static ConstantBufferFieldMapping _createFieldMapping(const char* name, size_t offsetBytes, size_t sizeBytes, const void* value)
-{
-    ConstantBufferFieldMapping mapping{};
-    mapping.name = name;
-    mapping.offsetBytes = offsetBytes;
-    mapping.sizeBytes = sizeBytes;
-    memcpy(&mapping.defaultValue, value, sizeof(ConstantBufferFieldMapping::defaultValue));
-    return mapping;
-}
-#define createFieldMapping(bufferStruct, bufferField, value) \
-    _createFieldMapping((#bufferField), offsetof(bufferStruct, bufferField), sizeof(bufferStruct::bufferField), (value))
-
-ConstantBuffer constantBuffer{};
+static ComPtr<ID3D11Buffer> s_objectConstantBuffer;   // per draw upload when offsets aren't available
+static ComPtr<ID3D11Buffer> s_objectVariablesBuffer;  // a block per draw command, bound by offset
+static ComPtr<ID3D11Buffer> s_frameConstantBuffer;
+static ComPtr<ID3D11Buffer> s_lightConstantBuffer;
+static ComPtr<ID3D11Buffer> s_instanceBuffer;
 
 struct Shader
 {
     ComPtr<ID3D11VertexShader> vs;
     ComPtr<ID3D11PixelShader> ps;
     ComPtr<ID3D11InputLayout> layout;
+    // compiled with INSTANCED, reads the object variables from the instance stream in slot 1
+    ComPtr<ID3D11VertexShader> instancedVs;
+    ComPtr<ID3D11InputLayout> instancedLayout;
 };
 
 Shader shaders[(i32)ShaderType::Max] = {};
 
 ComPtr<ID3D11RasterizerState> rasterizerStates[(i32)RasterizerState::Max] = {};
 
-static ID3DBlob* compileShader(const wchar_t* srcPath, const wchar_t* entryPoint, const char* target)
+// dx11 has no pipeline state objects, a baked state resolves its desc to the objects to bind once, and switching
+// between two of them only sets the parts that differ
+struct PipelineState
+{
+    ID3D11InputLayout* layout;
+    ID3D11VertexShader* vs;
+    ID3D11PixelShader* ps;
+    ID3D11RasterizerState* rasterizer;
+    ID3D11DepthStencilState* depthStencil;
+    D3D11_PRIMITIVE_TOPOLOGY topology;
+};
+
+static PipelineState s_pipelineStates[MAX_PIPELINE_STATES];
+static u32 s_pipelineStatesBaked;
+
+static ID3DBlob* compileShader(
+    const wchar_t* srcPath, const wchar_t* entryPoint, const char* target, const D3D_SHADER_MACRO* defines = nullptr)
 {
     ID3DBlob* resultBlob = nullptr;
     ID3DBlob* errorBlob = nullptr;
@@ -78,7 +74,7 @@ static ID3DBlob* compileShader(const wchar_t* srcPath, const wchar_t* entryPoint
     wcstombs(entryPointMB, entryPoint, sizeof(entryPointMB));
 
     const auto hr = D3DCompileFromFile(srcPath,
-        nullptr,
+        defines,
         D3D_COMPILE_STANDARD_FILE_INCLUDE,
         entryPointMB,
         target,
@@ -109,6 +105,9 @@ static Shader createShader(const wchar_t* path)
     defer({ vsBlob->Release(); });
     const auto psBlob = compileShader(path, L"PS_Main", "ps_5_0");
     defer({ psBlob->Release(); });
+    const D3D_SHADER_MACRO instancedDefines[] = {{"INSTANCED", "1"}, {nullptr, nullptr}};
+    const auto instancedVsBlob = compileShader(path, L"VS_Main", "vs_5_0", instancedDefines);
+    defer({ instancedVsBlob->Release(); });
 
     ID3D11VertexShader* vs = nullptr;
     ID3D11PixelShader* ps = nullptr;
@@ -127,55 +126,62 @@ static Shader createShader(const wchar_t* path)
         layoutDesc, ARR_LENGTH(layoutDesc), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &layout));
     shader.layout = layout;
 
+    ID3D11VertexShader* instancedVs = nullptr;
+    HR_ASSERT(s_device->CreateVertexShader(
+        instancedVsBlob->GetBufferPointer(), instancedVsBlob->GetBufferSize(), nullptr, &instancedVs));
+    shader.instancedVs = instancedVs;
+
+    using Instance = Shaders::InstanceVariables;
+    D3D11_INPUT_ELEMENT_DESC instancedLayoutDesc[] = {
+        layoutDesc[0],
+        layoutDesc[1],
+        layoutDesc[2],
+        {"INSTANCE_WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Instance, world[0]), D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"INSTANCE_WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Instance, world[1]), D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"INSTANCE_WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Instance, world[2]), D3D11_INPUT_PER_INSTANCE_DATA, 1},
+        {"INSTANCE_COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Instance, objectColor), D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    };
+    ID3D11InputLayout* instancedLayout = nullptr;
+    HR_ASSERT(s_device->CreateInputLayout(instancedLayoutDesc,
+        ARR_LENGTH(instancedLayoutDesc),
+        instancedVsBlob->GetBufferPointer(),
+        instancedVsBlob->GetBufferSize(),
+        &instancedLayout));
+    shader.instancedLayout = instancedLayout;
+
     return shader;
 }
 
-static ID3D11Buffer* createVertexBuffer(Vertex const* vertices, size_t vertexCount)
+static ID3D11Buffer* createMeshBuffer(size_t sizeBytes, UINT bindFlags)
 {
     ID3D11Buffer* buffer;
 
     D3D11_BUFFER_DESC bd = {};
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.BindFlags = bindFlags;
+    bd.Usage = D3D11_USAGE_DEFAULT;
     bd.CPUAccessFlags = 0;
     bd.MiscFlags = 0;
-    bd.StructureByteStride = sizeof(Vertex);
-    bd.ByteWidth = UINT(sizeof(Vertex) * vertexCount);
+    bd.ByteWidth = UINT(sizeBytes);
 
-    D3D11_SUBRESOURCE_DATA sd = {};
-    sd.pSysMem = vertices;
-
-    HR_ASSERT(s_device->CreateBuffer(&bd, &sd, &buffer));
+    HR_ASSERT(s_device->CreateBuffer(&bd, nullptr, &buffer));
 
     return buffer;
 }
 
-static ID3D11Buffer* createIndexBuffer(u32 const* indices, size_t indexCount)
+static void updateBufferRange(ID3D11Buffer* buffer, size_t offsetBytes, const void* data, size_t sizeBytes)
 {
-    ID3D11Buffer* buffer;
-
-    D3D11_BUFFER_DESC bd = {};
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bd.Usage = D3D11_USAGE_IMMUTABLE;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = 0;
-    bd.ByteWidth = UINT(sizeof(u32) * indexCount);
-
-    D3D11_SUBRESOURCE_DATA sd = {};
-    sd.pSysMem = indices;
-
-    HR_ASSERT(s_device->CreateBuffer(&bd, &sd, &buffer));
-
-    return buffer;
+    const D3D11_BOX box = {
+        .left = (UINT)offsetBytes, .top = 0, .front = 0, .right = UINT(offsetBytes + sizeBytes), .bottom = 1, .back = 1};
+    s_deviceContext->UpdateSubresource(buffer, 0, &box, data, 0, 0);
 }
 
-static ID3D11Buffer* createConstantBuffer()
+static ID3D11Buffer* createConstantBuffer(size_t sizeBytes)
 {
     ID3D11Buffer* buffer = nullptr;
 
     D3D11_BUFFER_DESC cbDesc = {};
     cbDesc.Usage = D3D11_USAGE_DYNAMIC;
-    cbDesc.ByteWidth = sizeof(Shaders::Variables);
+    cbDesc.ByteWidth = (UINT)sizeBytes;
     cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
@@ -184,6 +190,51 @@ static ID3D11Buffer* createConstantBuffer()
     return buffer;
 }
 
+// draws bind their block of one large buffer by offset, which needs a 11.1 runtime and driver support.
+// without it they fall back to uploading their variables into s_objectConstantBuffer one at a time
+static void createObjectVariablesBuffer(RenderState& state)
+{
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    ComPtr<ID3D11DeviceContext1> deviceContext1;
+    if (FAILED(s_deviceContext.As(&deviceContext1)) ||
+        FAILED(s_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+        !options.ConstantBufferOffsetting)
+    {
+        logInfo("constant buffer offsets not supported, object variables are uploaded per draw");
+        return;
+    }
+
+    s_deviceContext1 = deviceContext1;
+    s_constantBufferPartialUpdate = options.ConstantBufferPartialUpdate;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.ByteWidth = (UINT)(state.drawCommands.capacity * Shaders::OBJECT_VARIABLES_BLOCK_SIZE);
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    ID3D11Buffer* buffer = nullptr;
+    HR_ASSERT(s_device->CreateBuffer(&desc, nullptr, &buffer));
+    s_objectVariablesBuffer = buffer;
+
+    // everything is uploaded on the first frame
+    renderMarkObjectVariablesDirty(state);
+}
+
+static ID3D11Buffer* createInstanceBuffer(size_t sizeBytes)
+{
+    ID3D11Buffer* buffer = nullptr;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.ByteWidth = (UINT)sizeBytes;
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HR_ASSERT(s_device->CreateBuffer(&desc, nullptr, &buffer));
+
+    return buffer;
+}
+
 static ID3D11RasterizerState* createRasterizerState(RasterizerState state)
 {
     D3D11_RASTERIZER_DESC rasterizerDesc = {};
@@ -404,6 +455,13 @@ static void debugListAliveObjects()
     }
 }
 
+// the first asset with a given name wins, the faces of a cubemap all share its name
+static void internAsset(HashMap<AssetId, u32>& ids, Asset const& asset, size_t index)
+{
+    if (!mapAt(ids, asset.id))
+        mapInsert(ids, asset.id, (u32)index);
+}
+
 void renderInitResources(RenderState& state, Array<Asset>* assets)
 {
     ENSURE(g_context);
@@ -421,6 +479,7 @@ void renderInitResources(RenderState& state, Array<Asset>* assets)
         auto mesh = loadMesh(asset, g_context->gameMemory, g_context->tempMemory);
         mesh.id = i;
         arrayPush(state.meshes, mesh);
+        internAsset(state.meshIds, asset, i);
     }
 
     const auto textures = assets[(i32)AssetType::Texture];
@@ -436,6 +495,7 @@ void renderInitResources(RenderState& state, Array<Asset>* assets)
                 .channels = asset.textureChannels,
                 .gpuTextureId = i,
                 .isCubemap = false});
+        internAsset(state.textureIds, asset, i);
     }
 
     const auto cubemapTextures = assets[(i32)AssetType::CubemapTexture];
@@ -453,6 +513,7 @@ void renderInitResources(RenderState& state, Array<Asset>* assets)
                 .channels = asset.textureChannels,
                 .gpuTextureId = id,
                 .isCubemap = true});
+        internAsset(state.cubemapIds, asset, i);
     }
 
     state.spMeshTextures = arraySpan(state.allTextures, 0, textures.size);
@@ -492,19 +553,16 @@ void renderInit(RenderState& state, void* window)
     s_deviceContext->OMSetRenderTargets(1, s_rtView.GetAddressOf(), s_dsView.Get());
 
     ENSURE(g_context);
-    arrayInit(s_vertexBuffers, (size_t)GeneratedMesh::Max + state.meshes.size, g_context->gameMemory, "s_vertexBuffers");
-    arrayInit(s_indexBuffers, (size_t)GeneratedMesh::Max, g_context->gameMemory, "s_indexBuffers");
+    rangeAllocatorInit(state.meshVertices, MAX_MESH_VERTICES, MAX_MESH_RANGES, g_context->gameMemory);
+    rangeAllocatorInit(state.meshIndices, MAX_MESH_INDICES, MAX_MESH_RANGES, g_context->gameMemory);
+    s_meshVertexBuffer = createMeshBuffer(MAX_MESH_VERTICES * sizeof(Vertex), D3D11_BIND_VERTEX_BUFFER);
+    s_meshIndexBuffer = createMeshBuffer(MAX_MESH_INDICES * sizeof(u32), D3D11_BIND_INDEX_BUFFER);
     arrayInit(s_textureViews, state.spMeshTextures.size + state.spCubemaps.size / 6, g_context->gameMemory, "s_textureViews");
-    for (int i = 0; i < (i32)GeneratedMesh::Max; ++i)
-    {
-        arrayPush(s_vertexBuffers, createVertexBuffer(state.generatedMeshes[i].vertices, state.generatedMeshes[i].verticesCount));
-        arrayPush(s_indexBuffers, createIndexBuffer(state.generatedMeshes[i].indices, state.generatedMeshes[i].indicesCount));
-    }
+    for (auto& mesh : state.generatedMeshes)
+        ENSURE(renderUploadMesh(state, mesh));
 
-    for (const auto& mesh : state.meshes)
-    {
-        arrayPush(s_vertexBuffers, createVertexBuffer(mesh.vertices, mesh.verticesCount));
-    }
+    for (auto& mesh : state.meshes)
+        ENSURE(renderUploadMesh(state, mesh));
 
     for (const auto& texture : state.spMeshTextures)
     {
@@ -524,17 +582,16 @@ void renderInit(RenderState& state, void* window)
         shaders[i] = createShader(SHADER_PATH[i]);
     }
 
-    constantBuffer = {.buffer = createConstantBuffer(),
-        .mappings = {
-            createFieldMapping(Shaders::Variables, mvp, &Shaders::DEFAULT_VARIABLES.mvp),
-            createFieldMapping(Shaders::Variables, time, &Shaders::DEFAULT_VARIABLES.time),
-            createFieldMapping(Shaders::Variables, objectColor, &Shaders::DEFAULT_VARIABLES.objectColor),
-            createFieldMapping(Shaders::Variables, world, &Shaders::DEFAULT_VARIABLES.world),
-            createFieldMapping(Shaders::Variables, lightPosition, &Shaders::DEFAULT_VARIABLES.lightPosition),
-            createFieldMapping(Shaders::Variables, lightDirection, &Shaders::DEFAULT_VARIABLES.lightDirection),
-            createFieldMapping(Shaders::Variables, lightColor, &Shaders::DEFAULT_VARIABLES.lightColor),
-            createFieldMapping(Shaders::Variables, lightType, &Shaders::DEFAULT_VARIABLES.lightType),
-        }};
+    s_objectConstantBuffer = createConstantBuffer(sizeof(Shaders::ObjectVariables));
+    createObjectVariablesBuffer(state);
+    s_instanceBuffer = createInstanceBuffer(MAX_INSTANCES * sizeof(Shaders::InstanceVariables));
+    s_frameConstantBuffer = createConstantBuffer(sizeof(Shaders::FrameVariables));
+    s_lightConstantBuffer = createConstantBuffer(sizeof(Shaders::LightVariables));
+
+    state.frameVariables = {};
+    state.lightVariables = Shaders::DEFAULT_LIGHT_VARIABLES;
+    state.frameVariablesDirty = true;
+    state.lightVariablesDirty = true;
 
     rasterizerStates[(i32)RasterizerState::Default] = createRasterizerState(RasterizerState::Default);
     rasterizerStates[(i32)RasterizerState::Wireframe] = createRasterizerState(RasterizerState::Wireframe);
@@ -557,24 +614,28 @@ void renderDeinit()
     if (s_device)
         s_device.Reset();
 
-    for (auto& buffer : s_vertexBuffers)
-        buffer->Release();
-    for (auto& buffer : s_indexBuffers)
-        buffer->Release();
-    arrayClear(s_vertexBuffers, "s_vertexBuffers");
-    arrayClear(s_indexBuffers, "s_indexBuffers");
+    s_meshVertexBuffer.Reset();
+    s_meshIndexBuffer.Reset();
     arrayClear(s_textureViews, "s_textureViews");
 
-    constantBuffer.buffer.Reset();
+    s_objectConstantBuffer.Reset();
+    s_objectVariablesBuffer.Reset();
+    s_deviceContext1.Reset();
+    s_instanceBuffer.Reset();
+    s_frameConstantBuffer.Reset();
+    s_lightConstantBuffer.Reset();
 
     for (auto& shader : shaders)
     {
         shader.vs.Reset();
         shader.ps.Reset();
         shader.layout.Reset();
+        shader.instancedVs.Reset();
+        shader.instancedLayout.Reset();
     }
     for (auto& state : rasterizerStates)
         state.Reset();
+    s_pipelineStatesBaked = 0;
 
     if (s_deviceContext)
     {
@@ -583,103 +644,259 @@ void renderDeinit()
     }
 }
 
-static void writeShaderVariables(ShaderType shader, const ShaderVariable* variables, size_t variablesCount)
+static void uploadDynamicBuffer(ID3D11Buffer* buffer, const void* data, size_t sizeBytes)
 {
-    if (shader >= ShaderType::Max)
-        LOGIC_ERROR();
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HR_ASSERT(s_deviceContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
 
-    auto buffer = constantBuffer;
+    memcpy((uint8_t*)mappedResource.pData, data, sizeBytes);
 
-    size_t dataSizeBytes = sizeof(Shaders::Variables);
-    auto data = (u8*)alloca(dataSizeBytes);
+    s_deviceContext->Unmap(buffer, 0);
+}
 
-    for (size_t i = 0; i < variablesCount; ++i)
+static void writeShaderVariables(Shaders::ObjectVariables const& variables)
+{
+    uploadDynamicBuffer(s_objectConstantBuffer.Get(), &variables, sizeof(variables));
+
+    s_deviceContext->VSSetConstantBuffers(Shaders::OBJECT_VARIABLES_SLOT, 1, s_objectConstantBuffer.GetAddressOf());
+    s_deviceContext->PSSetConstantBuffers(Shaders::OBJECT_VARIABLES_SLOT, 1, s_objectConstantBuffer.GetAddressOf());
+}
+
+static void uploadObjectVariables(RenderState& state)
+{
+    // without the blocks buffer every draw writes its own variables, there is nothing to pack or upload
+    if (!s_objectVariablesBuffer)
     {
-        const auto& variable = variables[i];
-        if (!variable.name)
-            continue;
+        for (auto& command : state.drawCommands)
+            command.variablesDirty = false;
+        return;
+    }
+
+    renderPackObjectVariables(state);
+    const auto scratch = arenaScratchBegin();
+    defer({ arenaTempEnd(scratch); });
+    const auto dirty = renderGetDirtyObjectVariables(state, *scratch.arena);
+    if (dirty.count == 0)
+        return;
 
-        const auto mapping = find(buffer.mappings,
-            MAX_SHADER_VARIABLES,
-            [variable](auto const& mapping) { return strncmp(mapping.name, variable.name, 256) == 0; });
-        if (mapping)
+    if (s_constantBufferPartialUpdate)
+    {
+        // a copy per run of changed blocks
+        for (size_t i = 0; i < dirty.count; ++i)
         {
-            memcpy(data + mapping->offsetBytes, &variable.value, mapping->sizeBytes);
+            const auto begin = dirty.runs[i].begin * Shaders::OBJECT_VARIABLES_BLOCK_SIZE;
+            const auto end = dirty.runs[i].end * Shaders::OBJECT_VARIABLES_BLOCK_SIZE;
+            const D3D11_BOX box = {.left = begin, .top = 0, .front = 0, .right = end, .bottom = 1, .back = 1};
+            s_deviceContext1->UpdateSubresource1(
+                s_objectVariablesBuffer.Get(), 0, &box, state.objectVariables + begin, 0, 0, 0);
         }
     }
+    else
+    {
+        // without partial updates a constant buffer only takes a null box, so the union of the runs can't go alone
+        s_deviceContext->UpdateSubresource(s_objectVariablesBuffer.Get(), 0, nullptr, state.objectVariables, 0, 0);
+    }
 
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    HR_ASSERT(s_deviceContext->Map(buffer.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
-
-    memcpy((uint8_t*)mappedResource.pData, data, dataSizeBytes);
+    renderObjectVariablesUploaded(state);
+}
 
-    s_deviceContext->Unmap(buffer.buffer.Get(), 0);
+static void bindObjectVariables(DrawCommand const& command)
+{
+    if (!s_objectVariablesBuffer)
+    {
+        writeShaderVariables(command.variables);
+        return;
+    }
 
-    s_deviceContext->VSSetConstantBuffers(0, 1, buffer.buffer.GetAddressOf());
-    s_deviceContext->PSSetConstantBuffers(0, 1, buffer.buffer.GetAddressOf());
+    static constexpr UINT constantsCount = Shaders::OBJECT_VARIABLES_BLOCK_SIZE / 16;
+    const UINT firstConstant = command.variablesBlock * constantsCount;
+    s_deviceContext1->VSSetConstantBuffers1(
+        Shaders::OBJECT_VARIABLES_SLOT, 1, s_objectVariablesBuffer.GetAddressOf(), &firstConstant, &constantsCount);
+    s_deviceContext1->PSSetConstantBuffers1(
+        Shaders::OBJECT_VARIABLES_SLOT, 1, s_objectVariablesBuffer.GetAddressOf(), &firstConstant, &constantsCount);
 }
 
-void renderDraw(DrawCommand const& command)
+void renderBeginFrame(RenderState& state)
 {
-    if (!bool(command.flags & DrawFlag::Active))
-        return;
+    uploadObjectVariables(state);
 
-    ENSURE(command.mesh != nullptr);
+    // the gui and the clears bind their own state between frames
+    invalidateBoundDrawState(state);
 
-    writeShaderVariables(command.shader, command.variables, MAX_SHADER_VARIABLES);
+    u32 stride = sizeof(Vertex), offset = 0;
+    s_deviceContext->IASetVertexBuffers(0, 1, s_meshVertexBuffer.GetAddressOf(), &stride, &offset);
+    s_deviceContext->IASetIndexBuffer(s_meshIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 
-    s_deviceContext->IASetPrimitiveTopology(command.rasterizerState == RasterizerState::Wireframe
-                                                ? D3D11_PRIMITIVE_TOPOLOGY_LINELIST
-                                                : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (state.frameVariablesDirty)
+    {
+        uploadDynamicBuffer(s_frameConstantBuffer.Get(), &state.frameVariables, sizeof(state.frameVariables));
+        state.frameVariablesDirty = false;
+    }
 
-    for (UINT i = 0; i < MAX_TEXTURE_SLOTS; ++i)
+    if (state.lightVariablesDirty)
     {
-        const auto& texture = command.textures[i];
-        if (!texture)
-            continue;
+        uploadDynamicBuffer(s_lightConstantBuffer.Get(), &state.lightVariables, sizeof(state.lightVariables));
+        state.lightVariablesDirty = false;
+    }
 
-        if (texture->isCubemap)
-            s_deviceContext->PSSetSamplers(i, 1, &s_cubeMapTextureSampler);
-        else
-            s_deviceContext->PSSetSamplers(i, 1, &s_textureSampler);
+    s_deviceContext->VSSetConstantBuffers(Shaders::FRAME_VARIABLES_SLOT, 1, s_frameConstantBuffer.GetAddressOf());
+    s_deviceContext->PSSetConstantBuffers(Shaders::FRAME_VARIABLES_SLOT, 1, s_frameConstantBuffer.GetAddressOf());
+    s_deviceContext->VSSetConstantBuffers(Shaders::LIGHT_VARIABLES_SLOT, 1, s_lightConstantBuffer.GetAddressOf());
+    s_deviceContext->PSSetConstantBuffers(Shaders::LIGHT_VARIABLES_SLOT, 1, s_lightConstantBuffer.GetAddressOf());
+}
 
-        s_deviceContext->PSSetShaderResources(i, 1, &s_textureViews[texture->gpuTextureId]);
+static PipelineState& getBakedPipelineState(RenderState const& state, u32 index)
+{
+    for (; s_pipelineStatesBaked <= index; ++s_pipelineStatesBaked)
+    {
+        const auto& desc = state.pipelineStates[s_pipelineStatesBaked];
+        const auto& shader = shaders[(i32)desc.shader];
+        s_pipelineStates[s_pipelineStatesBaked] = {
+            .layout = desc.instanced ? shader.instancedLayout.Get() : shader.layout.Get(),
+            .vs = desc.instanced ? shader.instancedVs.Get() : shader.vs.Get(),
+            .ps = shader.ps.Get(),
+            .rasterizer = rasterizerStates[(i32)desc.rasterizerState].Get(),
+            .depthStencil = desc.depthWrite ? s_depthStencilDefault : s_depthStencilNoWrite,
+            .topology = desc.rasterizerState == RasterizerState::Wireframe ? D3D11_PRIMITIVE_TOPOLOGY_LINELIST
+                                                                             : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
+        };
     }
+    return s_pipelineStates[index];
+}
 
-    auto& shader = shaders[(i32)command.shader];
-    s_deviceContext->IASetInputLayout(shader.layout.Get());
-    s_deviceContext->VSSetShader(shader.vs.Get(), nullptr, 0);
-    s_deviceContext->PSSetShader(shader.ps.Get(), nullptr, 0);
-
-    s_deviceContext->RSSetState(rasterizerStates[(i32)command.rasterizerState].Get());
+static void bindPipelineState(RenderState const& state, u32 previousIndex, u32 index)
+{
+    const auto& next = getBakedPipelineState(state, index);
+    const auto previous = previousIndex != NO_PIPELINE_STATE ? &getBakedPipelineState(state, previousIndex) : nullptr;
+
+    if (!previous || previous->layout != next.layout)
+        s_deviceContext->IASetInputLayout(next.layout);
+    if (!previous || previous->vs != next.vs)
+        s_deviceContext->VSSetShader(next.vs, nullptr, 0);
+    if (!previous || previous->ps != next.ps)
+        s_deviceContext->PSSetShader(next.ps, nullptr, 0);
+    if (!previous || previous->rasterizer != next.rasterizer)
+        s_deviceContext->RSSetState(next.rasterizer);
+    if (!previous || previous->depthStencil != next.depthStencil)
+        s_deviceContext->OMSetDepthStencilState(next.depthStencil, 0);
+    if (!previous || previous->topology != next.topology)
+        s_deviceContext->IASetPrimitiveTopology(next.topology);
+}
 
-    if (bool(command.flags & DrawFlag::DepthWrite))
+static void bindTextures(DrawCommand const& command, u32 slots)
+{
+    for (UINT i = 0; i < MAX_TEXTURE_SLOTS; ++i)
     {
-        s_deviceContext->OMSetDepthStencilState(s_depthStencilDefault, 0);
+        if (!(slots & (1u << i)))
+            continue;
+
+        const auto& texture = command.textures[i];
+        ID3D11ShaderResourceView* view = nullptr;
+        ID3D11SamplerState* sampler = nullptr;
+        if (texture)
+        {
+            view = s_textureViews[texture->gpuTextureId];
+            sampler = texture->isCubemap ? s_cubeMapTextureSampler : s_textureSampler;
+        }
+
+        s_deviceContext->PSSetShaderResources(i, 1, &view);
+        s_deviceContext->PSSetSamplers(i, 1, &sampler);
     }
-    else
+}
+
+bool renderUploadMesh(RenderState& state, Mesh& mesh)
+{
+    const auto indexed = bool(mesh.flags & MeshFlag::Indexed);
+    const auto vertices = rangeAlloc(state.meshVertices, (u32)mesh.verticesCount);
+    const auto indices = rangeAlloc(state.meshIndices, indexed ? (u32)mesh.indicesCount : 0);
+    if (vertices.offset == RANGE_ALLOC_FAILED || indices.offset == RANGE_ALLOC_FAILED)
     {
-        s_deviceContext->OMSetDepthStencilState(s_depthStencilNoWrite, 0);
+        logError("no room for mesh %.*s (%zu vertices, %zu indices)",
+            mesh.name.length,
+            mesh.name.data,
+            mesh.verticesCount,
+            mesh.indicesCount);
+        if (vertices.offset != RANGE_ALLOC_FAILED)
+            rangeFree(state.meshVertices, vertices);
+        if (indices.offset != RANGE_ALLOC_FAILED)
+            rangeFree(state.meshIndices, indices);
+        return false;
     }
 
-    u32 stride = sizeof(Vertex), offset = 0;
-    s_deviceContext->IASetVertexBuffers(0, 1, &s_vertexBuffers[getMeshBufferIndex(*command.mesh)], &stride, &offset);
+    mesh.baseVertex = vertices.offset;
+    mesh.firstIndex = indices.offset;
+    updateBufferRange(
+        s_meshVertexBuffer.Get(), vertices.offset * sizeof(Vertex), mesh.vertices, vertices.size * sizeof(Vertex));
+    if (indices.size)
+        updateBufferRange(s_meshIndexBuffer.Get(), indices.offset * sizeof(u32), mesh.indices, indices.size * sizeof(u32));
+
+    return true;
+}
+
+void renderFreeMesh(RenderState& state, Mesh& mesh)
+{
+    // a full free list only leaks the mesh's ranges, the buffers stay consistent
+    auto freed = rangeFree(state.meshVertices, {.offset = mesh.baseVertex, .size = (u32)mesh.verticesCount});
+    if (bool(mesh.flags & MeshFlag::Indexed))
+        freed &= rangeFree(state.meshIndices, {.offset = mesh.firstIndex, .size = (u32)mesh.indicesCount});
+    if (!freed)
+        logError("mesh buffers too fragmented, the space of mesh %.*s is lost", mesh.name.length, mesh.name.data);
+    mesh.baseVertex = mesh.firstIndex = 0;
+}
+
+static void bindDrawState(RenderState& state, DrawCommand const& command, bool instanced)
+{
+    const auto changes = trackDrawState(state, command, instanced);
+    if (bool(changes.changes & DrawStateChange::PipelineState))
+        bindPipelineState(state, changes.previousPipelineState, changes.pipelineState);
+    if (bool(changes.changes & DrawStateChange::Textures))
+        bindTextures(command, changes.textureSlots);
+}
+
+void renderDraw(RenderState& state, DrawCommand const& command)
+{
+    if (!bool(command.flags & DrawFlag::Active))
+        return;
+
+    ENSURE(command.mesh != nullptr);
+
+    bindDrawState(state, command, false);
+    bindObjectVariables(command);
 
     if (bool(command.mesh->flags & MeshFlag::Indexed))
-    {
-        s_deviceContext->IASetIndexBuffer(s_indexBuffers[getMeshBufferIndex(*command.mesh)], DXGI_FORMAT_R32_UINT, 0);
-        s_deviceContext->DrawIndexed((UINT)command.mesh->indicesCount, 0, 0);
-    }
+        s_deviceContext->DrawIndexed((UINT)command.mesh->indicesCount, command.mesh->firstIndex, command.mesh->baseVertex);
     else
-    {
-        s_deviceContext->Draw((UINT)command.mesh->verticesCount, 0);
-    }
+        s_deviceContext->Draw((UINT)command.mesh->verticesCount, command.mesh->baseVertex);
+}
+
+void renderUploadInstances(DrawBatches const& batches)
+{
+    if (!batches.instancesCount)
+        return;
+
+    ENSURE(batches.instancesCount <= MAX_INSTANCES);
+    uploadDynamicBuffer(
+        s_instanceBuffer.Get(), batches.instances, batches.instancesCount * sizeof(Shaders::InstanceVariables));
+
+    u32 stride = sizeof(Shaders::InstanceVariables), offset = 0;
+    s_deviceContext->IASetVertexBuffers(1, 1, s_instanceBuffer.GetAddressOf(), &stride, &offset);
+}
+
+void renderDrawInstanced(RenderState& state, DrawCommand const& command, u32 firstInstance, u32 instanceCount)
+{
+    ENSURE(command.mesh != nullptr);
 
-    ID3D11ShaderResourceView* textureSlots[]{nullptr, nullptr, nullptr};
-    s_deviceContext->PSSetShaderResources(0, 3, textureSlots);
+    bindDrawState(state, command, true);
 
-    ID3D11SamplerState* nullSamplers[] = {nullptr, nullptr};
-    s_deviceContext->PSSetSamplers(0, 2, nullSamplers);
+    if (bool(command.mesh->flags & MeshFlag::Indexed))
+        s_deviceContext->DrawIndexedInstanced((UINT)command.mesh->indicesCount,
+            instanceCount,
+            command.mesh->firstIndex,
+            command.mesh->baseVertex,
+            firstInstance);
+    else
+        s_deviceContext->DrawInstanced(
+            (UINT)command.mesh->verticesCount, instanceCount, command.mesh->baseVertex, firstInstance);
 }
 
 void renderClearAndResize(RenderState& state, glm::vec4 color)
@@ -708,16 +925,3 @@ void renderPresent()
 {
     s_swapChain->Present(1, 0);
 }
-
-void createShaderVariables(DrawCommand& command)
-{
-    for (int i = 0; i < MAX_SHADER_VARIABLES; ++i)
-    {
-        auto& mapping = constantBuffer.mappings[i];
-        command.variables[i] = {
-            .name = mapping.name,
-            .value = {},
-        };
-        memcpy(&command.variables[i].value, &mapping.defaultValue, mapping.sizeBytes);
-    }
-}
@@ -2,99 +2,41 @@
 #include "platform.hpp"
 #include "renderer.hpp"
 
-static ShaderVariable* getVariableByName(ShaderVariable* variables, const char* name)
+void setShaderTime(RenderState& state, float time)
 {
-    auto var = find(variables,
-        MAX_SHADER_VARIABLES,
-        [name](ShaderVariable& var)
-        {
-            if (!var.name)
-                return false;
-            return strncmp(var.name, name, 256) == 0;
-        });
-    ENSURE(var != nullptr);
-    return var;
+    state.frameVariables.time = time;
+    state.frameVariablesDirty = true;
 }
 
-void setShaderVariableInt(DrawCommand& command, const char* variableName, int value)
+void setShaderCamera(RenderState& state, mat4 const& viewProjection, vec3 position)
 {
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.i = value;
-    var->value = newValue;
+    // transposed like every matrix handed to the shaders
+    const auto transposed = transpose(viewProjection);
+    memcpy(state.frameVariables.viewProjection, &transposed, sizeof(state.frameVariables.viewProjection));
+    memcpy(state.frameVariables.cameraPosition, &position, sizeof(state.frameVariables.cameraPosition));
+    state.frameVariablesDirty = true;
 }
 
-void setShaderVariableFloat(DrawCommand& command, const char* variableName, float value)
+void setShaderLightColor(RenderState& state, vec4 color)
 {
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.f = value;
-    var->value = newValue;
+    memcpy(state.lightVariables.lightColor, &color, sizeof(state.lightVariables.lightColor));
+    state.lightVariablesDirty = true;
 }
 
-void setShaderVariableVec2(DrawCommand& command, const char* variableName, vec2 value)
+void setShaderLightDirection(RenderState& state, vec3 direction)
 {
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.v2 = value;
-    var->value = newValue;
+    memcpy(state.lightVariables.lightDirection, &direction, sizeof(state.lightVariables.lightDirection));
+    state.lightVariablesDirty = true;
 }
 
-void setShaderVariableVec3(DrawCommand& command, const char* variableName, vec3 value)
+void setShaderLightPosition(RenderState& state, vec3 position)
 {
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.v3 = value;
-    var->value = newValue;
+    memcpy(state.lightVariables.lightPosition, &position, sizeof(state.lightVariables.lightPosition));
+    state.lightVariablesDirty = true;
 }
 
-void setShaderVariableVec4(DrawCommand& command, const char* variableName, vec4 value)
+void setShaderLightType(RenderState& state, int type)
 {
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.v4 = value;
-    var->value = newValue;
-}
-
-void setShaderVariableMat4(DrawCommand& command, const char* variableName, mat4 value)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    ShaderVariableValue newValue;
-    newValue.m4 = value;
-    var->value = newValue;
-}
-float getShaderVariableFloat(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.f;
-}
-
-i32 getShaderVariableInt(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.i;
-}
-
-vec2 getShaderVariableVec2(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.v2;
-}
-
-vec3 getShaderVariableVec3(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.v3;
-}
-
-vec4 getShaderVariableVec4(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.v4;
-}
-
-mat4 getShaderVariableMat4(DrawCommand& command, const char* variableName)
-{
-    auto var = getVariableByName(command.variables, variableName);
-    return var->value.m4;
+    state.lightVariables.lightType = type;
+    state.lightVariablesDirty = true;
 }
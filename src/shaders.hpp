@@ -2,20 +2,15 @@
 
 #include "common/common.hpp"
 
-struct DrawCommand;
-
-void setShaderVariableInt(DrawCommand& command, const char* variableName, int value);
-void setShaderVariableFloat(DrawCommand& command, const char* variableName, float value);
-void setShaderVariableVec2(DrawCommand& command, const char* variableName, vec2 value);
-void setShaderVariableVec3(DrawCommand& command, const char* variableName, vec3 value);
-void setShaderVariableVec4(DrawCommand& command, const char* variableName, vec4 value);
-void setShaderVariableMat4(DrawCommand& command, const char* variableName, mat4 value);
-int getShaderVariableInt(DrawCommand& command, const char* variableName);
-float getShaderVariableFloat(DrawCommand& command, const char* variableName);
-vec2 getShaderVariableVec2(DrawCommand& command, const char* variableName);
-vec3 getShaderVariableVec3(DrawCommand& command, const char* variableName);
-vec4 getShaderVariableVec4(DrawCommand& command, const char* variableName);
-mat4 getShaderVariableMat4(DrawCommand& command, const char* variableName);
+struct RenderState;
+
+// variables shared by every draw are written once into their own constant buffer instead of into each command
+void setShaderTime(RenderState& state, float time);
+void setShaderCamera(RenderState& state, mat4 const& viewProjection, vec3 position);
+void setShaderLightColor(RenderState& state, vec4 color);
+void setShaderLightDirection(RenderState& state, vec3 direction);
+void setShaderLightPosition(RenderState& state, vec3 position);
+void setShaderLightType(RenderState& state, int type);
 
 enum class ShaderType
 {
@@ -31,54 +26,87 @@ static constexpr const wchar_t* SHADER_PATH[] = {
     L"resources/shaders/dx11/skybox.hlsl",
 };
 
-static constexpr auto MAX_SHADER_VARIABLES = 10;
+namespace Shaders
+{
 
-union ShaderVariableValue
+// one constant buffer per update frequency, the slots match the registers in variables.hlsl
+static constexpr u32 FRAME_VARIABLES_SLOT = 0;
+static constexpr u32 LIGHT_VARIABLES_SLOT = 1;
+static constexpr u32 OBJECT_VARIABLES_SLOT = 2;
+
+// once per frame
+struct FrameVariables
 {
-    int i;
-    float f;
-    vec2 v2;
-    vec3 v3;
-    vec4 v4;
-    mat4 m4;
+    float viewProjection[4][4];
+    float cameraPosition[3];
+    float time;
 };
 
-struct ShaderVariable
+// when a light changes
+struct LightVariables
 {
-    const char* name;
-    ShaderVariableValue value;
+    float lightColor[4];
+    float lightDirection[3];
+    int lightType;
+    float lightPosition[3];
+    float _padding0;
 };
 
-namespace Shaders
+// for every draw, each draw command keeps a packed copy written through the ShaderSlot fields
+struct ObjectVariables
 {
+    float world[3][4];  // affine rows, the shader reads it as a row_major float3x4
+    float mvp[4][4];
+    float objectColor[4];
+};
 
-struct Variables
+// per instance of an instanced draw, read from a vertex stream. the mvp is built in the shader from the
+// frame's view-projection
+struct InstanceVariables
 {
-    float world[4][4];
-    float mvp[4][4];
+    float world[3][4];
     float objectColor[4];
-    float lightColor[4];
-    float lightDirection[3];
-    float _padding0;
-    float lightPosition[3];
-    float time;
-    int lightType;
-    float _padding1[3];
 };
 
-static_assert(sizeof(Variables) % 16 == 0, "Constant buffer size must be a multiple of 16 bytes");
+static_assert(sizeof(FrameVariables) % 16 == 0, "Constant buffer size must be a multiple of 16 bytes");
+static_assert(sizeof(LightVariables) % 16 == 0, "Constant buffer size must be a multiple of 16 bytes");
+static_assert(sizeof(ObjectVariables) % 16 == 0, "Constant buffer size must be a multiple of 16 bytes");
 
-static constexpr Variables DEFAULT_VARIABLES = {
-    .world = {},
-    .mvp = {},
-    .objectColor = {1.f, 1.f, 1.f, 1.f},
+// every draw command's object variables get a block of one large constant buffer. bound ranges start at and
+// span multiples of 16 constants of 16 bytes
+static constexpr u32 OBJECT_VARIABLES_BLOCK_SIZE = 256;
+static_assert(sizeof(ObjectVariables) <= OBJECT_VARIABLES_BLOCK_SIZE);
+
+static constexpr LightVariables DEFAULT_LIGHT_VARIABLES = {
     .lightColor = {1.f, 1.f, 1.f, 1.f},
     .lightDirection = {0.f, -0.7f, 1.f},
-    ._padding0 = {},
-    .lightPosition = {},
-    .time = 0.f,
     .lightType = 0,
-    ._padding1 = {},
+    .lightPosition = {},
+    ._padding0 = {},
+};
+
+static constexpr ObjectVariables DEFAULT_OBJECT_VARIABLES = {
+    .world = {},
+    .mvp = {},
+    .objectColor = {1.f, 1.f, 1.f, 1.f},
 };
 
 }  // namespace Shaders
+
+// typed offset of a per-object variable, setting one is a memcpy into the draw command's packed variables
+template <typename T>
+struct ShaderVariableSlot
+{
+    u32 offsetBytes;
+};
+
+#define SHADER_VARIABLE_SLOT(name, type, field)                                                             \
+    static_assert(sizeof(type) == sizeof(Shaders::ObjectVariables::field), "Slot type doesn't match " #field); \
+    static constexpr ShaderVariableSlot<type> name = {offsetof(Shaders::ObjectVariables, field)}
+
+namespace ShaderSlot
+{
+SHADER_VARIABLE_SLOT(World, Affine, world);
+SHADER_VARIABLE_SLOT(Mvp, mat4, mvp);
+SHADER_VARIABLE_SLOT(ObjectColor, vec4, objectColor);
+}  // namespace ShaderSlot
@@ -0,0 +1,77 @@
+#include "test.hpp"
+
+#include "common/math.cpp"
+#include "common/memory.cpp"
+#include "common/string.cpp"
+#include "geometry.cpp"
+
+// obj loading from in-memory sources
+
+static Arena s_memory;
+static Arena s_tempMemory;
+
+static Mesh loadObj(String source)
+{
+    const Asset asset = {
+        .data = (const u8*)source.data, .name = strL("test"), .size = source.length, .type = AssetType::ObjMesh};
+    return loadMesh(asset, s_memory, s_tempMemory);
+}
+
+static void testLoadsIndexedTriangles()
+{
+    const auto mesh = loadObj(strL("v 0 0 0\n"
+                                   "v 1 0 0\n"
+                                   "v 0 1 0\n"
+                                   "v 1 1 0\n"
+                                   "vn 0 0 1\n"
+                                   "f 1//1 2//1 3//1\n"
+                                   "f 2//1 4//1 -2//1\n"));
+    CHECK(bool(mesh.flags & MeshFlag::Indexed));
+    CHECK(mesh.indicesCount == 6);
+    CHECK(mesh.verticesCount == 4);
+    CHECK(mesh.indices[3] == mesh.indices[1] && mesh.indices[5] == mesh.indices[2]);
+}
+
+static void testInvalidFacesAreSkipped()
+{
+    const auto mesh = loadObj(strL("v 0 0 0\n"
+                                   "v 1 0 0\n"
+                                   "v 0 1 0\n"
+                                   "vt 0 0\n"
+                                   "f 1 2 3\n"
+                                   "f 1 2 4\n"        // past the last position
+                                   "f 1 2 -4\n"       // before the first
+                                   "f 1 2 3 0\n"      // indices are 1-based
+                                   "f 1/2 2/1 3/1\n"  // past the last uv
+                                   "f 1//1 2 3\n"     // no normals at all
+                                   "f 1 2x 3\n"
+                                   "f 1 2\n"
+                                   "f 3/1 2/1 1/1\n"));
+    CHECK(mesh.indicesCount == 6);
+    CHECK(mesh.verticesCount == 6);
+}
+
+static void testMeshesWithoutFacesAreEmpty()
+{
+    for (const auto source : {strL(""), strL("# nothing\n"), strL("v 0 0 0\nv 1 0 0\n"), strL("v 0 0 0\nf 1 1\n")})
+    {
+        const auto mesh = loadObj(source);
+        CHECK(!bool(mesh.flags & MeshFlag::Indexed));
+        CHECK(mesh.verticesCount == 0 && mesh.indicesCount == 0);
+        CHECK(mesh.name == strL("test"));
+    }
+}
+
+int main()
+{
+    arenaInitGrowable(s_memory, 16 * 1024 * 1024);
+    arenaInitGrowable(s_tempMemory, 16 * 1024 * 1024);
+
+    RUN_TEST(testLoadsIndexedTriangles);
+    RUN_TEST(testInvalidFacesAreSkipped);
+    RUN_TEST(testMeshesWithoutFacesAreEmpty);
+
+    arenaDeinit(s_tempMemory);
+    arenaDeinit(s_memory);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+#include "test.hpp"
+
+#include "common/memory.cpp"
+#include "common/hash_map.hpp"
+
+#include <random>
+#include <unordered_map>
+
+static Arena s_memory;
+
+// keys whose hash is chosen by the test, low 7 bits are the control tag and the rest picks the first group
+struct CollidingKey
+{
+    u32 value;
+    u32 hash;
+};
+
+uint64_t mapHashKey(CollidingKey const& key)
+{
+    return key.hash;
+}
+
+template <typename K, typename V>
+static size_t countIterated(HashMap<K, V>& map)
+{
+    size_t count = 0;
+    for (auto& entry : map)
+    {
+        (void)entry;
+        count++;
+    }
+    return count;
+}
+
+static void checkMatches(HashMap<u32, u32>& map, std::unordered_map<u32, u32> const& expected, u32 keyRange)
+{
+    CHECK(map.size == expected.size());
+    CHECK(countIterated(map) == expected.size());
+    for (u32 key = 0; key < keyRange; ++key)
+    {
+        const auto value = mapAt(map, key);
+        const auto found = expected.find(key);
+        if (found == expected.end())
+            CHECK(value == nullptr);
+        else
+            CHECK(value && *value == found->second);
+    }
+}
+
+static void testChurnMatchesUnorderedMap(Arena* arena)
+{
+    static constexpr u32 KEY_RANGE = 3000;
+    HashMap<u32, u32> map;
+    mapAlloc(map, 16, arena);
+    std::unordered_map<u32, u32> expected;
+
+    std::mt19937 random(7);
+    for (int step = 0; step < 200000; ++step)
+    {
+        const auto key = (u32)(random() % KEY_RANGE);
+        // the mix drifts between growing and shrinking so the table sees both tombstone and growth rehashes
+        const auto insertPercent = (step / 20000) % 2 ? 30u : 70u;
+        if (random() % 100 < insertPercent)
+        {
+            mapInsert(map, key, (u32)step);
+            expected[key] = (u32)step;
+        }
+        else
+        {
+            CHECK(mapErase(map, key) == (expected.erase(key) == 1));
+        }
+        CHECK((float)(map.size + map.tombstones) <= (float)map.capacity * LOAD_FACTOR);
+
+        if (step % 10000 == 0)
+            checkMatches(map, expected, KEY_RANGE);
+    }
+    checkMatches(map, expected, KEY_RANGE);
+
+    mapClear(map);
+    expected.clear();
+    checkMatches(map, expected, KEY_RANGE);
+    mapFree(map);
+}
+
+static void testChurnWithMalloc()
+{
+    testChurnMatchesUnorderedMap(nullptr);
+}
+
+static void testChurnInArena()
+{
+    arenaClear(s_memory);
+    testChurnMatchesUnorderedMap(&s_memory);
+}
+
+static void testTombstonesInAFullGroup()
+{
+    HashMap<CollidingKey, u32> map;
+    mapAlloc(map, 64);
+    CHECK(map.capacity == 64);
+
+    // every key starts probing at group 0, the ones past the first 16 spill into the next group
+    CollidingKey keys[20];
+    for (u32 i = 0; i < 20; ++i)
+    {
+        keys[i] = {.value = i, .hash = i & 0x7F};
+        mapInsert(map, keys[i], i);
+    }
+    for (u32 i = 0; i < 20; ++i)
+        CHECK(mapAt(map, keys[i]) && *mapAt(map, keys[i]) == i);
+
+    // group 0 has no empty slot, so its erased slots stay tombstones and the spilled keys stay reachable
+    for (u32 i = 0; i < 16; ++i)
+        CHECK(mapErase(map, keys[i]));
+    CHECK(map.tombstones == 16);
+    CHECK(map.size == 4);
+    for (u32 i = 0; i < 16; ++i)
+        CHECK(!mapAt(map, keys[i]));
+    for (u32 i = 16; i < 20; ++i)
+        CHECK(mapAt(map, keys[i]) && *mapAt(map, keys[i]) == i);
+
+    // inserting again reuses the tombstones, and updating a spilled key doesn't duplicate it
+    for (u32 i = 0; i < 8; ++i)
+        mapInsert(map, keys[i], i + 100);
+    mapInsert(map, keys[17], 200u);
+    CHECK(map.tombstones == 8);
+    CHECK(map.size == 12);
+    CHECK(countIterated(map) == 12);
+    CHECK(*mapAt(map, keys[17]) == 200);
+
+    // a group that still has an empty slot frees erased slots outright
+    CHECK(mapErase(map, keys[18]));
+    CHECK(map.tombstones == 8);
+
+    mapFree(map);
+}
+
+static void testTombstoneRehashKeepsCapacity()
+{
+    HashMap<CollidingKey, u32> map;
+    mapAlloc(map, 64);
+
+    // three full groups and half of the last one, right at the load factor
+    CollidingKey keys[56];
+    for (u32 i = 0; i < 56; ++i)
+    {
+        keys[i] = {.value = i, .hash = (i / 16) << 7 | (i & 0x7F)};
+        mapInsert(map, keys[i], i);
+    }
+    CHECK(map.capacity == 64);
+
+    for (u32 i = 0; i < 40; ++i)
+        CHECK(mapErase(map, keys[i]));
+    CHECK(map.tombstones == 40);
+
+    // mostly tombstones, so the next insert rehashes in place instead of growing
+    const CollidingKey extra = {.value = 100, .hash = 5};
+    mapInsert(map, extra, 100u);
+    CHECK(map.capacity == 64);
+    CHECK(map.tombstones == 0);
+    CHECK(map.size == 17);
+    CHECK(countIterated(map) == 17);
+    for (u32 i = 40; i < 56; ++i)
+        CHECK(mapAt(map, keys[i]) && *mapAt(map, keys[i]) == i);
+    CHECK(mapAt(map, extra) && *mapAt(map, extra) == 100);
+
+    mapFree(map);
+}
+
+int main()
+{
+    arenaInitGrowable(s_memory, 64 * 1024 * 1024);
+
+    RUN_TEST(testChurnWithMalloc);
+    RUN_TEST(testChurnInArena);
+    RUN_TEST(testTombstonesInAFullGroup);
+    RUN_TEST(testTombstoneRehashKeepsCapacity);
+
+    arenaDeinit(s_memory);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
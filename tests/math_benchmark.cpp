@@ -0,0 +1,87 @@
+#include "test.hpp"
+
+#include "common/math.cpp"
+#include "common/memory.cpp"
+#include "common/string.cpp"
+
+#include <chrono>
+
+// entity world transforms: the batched kernel against the per entity path and glm's matrix product it replaced.
+// the timings are informational, the run fails only when the results disagree
+
+static constexpr size_t ENTITIES_COUNT = 4099;  // not a multiple of the simd width, so the tail runs too
+static constexpr int REPEATS = 2000;
+static constexpr float TOLERANCE = 1e-4f;
+
+static vec3 s_positions[ENTITIES_COUNT];
+static quat s_rotations[ENTITIES_COUNT];
+static vec3 s_scales[ENTITIES_COUNT];
+static Affine s_batched[ENTITIES_COUNT];
+static Affine s_scalar[ENTITIES_COUNT];
+static mat4 s_matrices[ENTITIES_COUNT];
+
+// read back one result per repeat so the loops can't be dropped
+static volatile float s_sink;
+
+template <typename Func>
+static double measureMicroseconds(Func&& func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < REPEATS; ++repeat)
+        func(repeat);
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / REPEATS;
+}
+
+static float affineMaxDifference(Affine const& a, Affine const& b)
+{
+    float result = 0.f;
+    for (int row = 0; row < 3; ++row)
+        for (int column = 0; column < 4; ++column)
+            result = std::max(result, std::abs(a.rows[row][column] - b.rows[row][column]));
+    return result;
+}
+
+int main()
+{
+    for (size_t i = 0; i < ENTITIES_COUNT; ++i)
+    {
+        const auto angle = 0.001f * (float)i;
+        s_positions[i] = vec3((float)i * 0.5f, -(float)i, 2.f);
+        s_rotations[i] = quat(std::cos(angle), std::sin(angle) * 0.6f, std::sin(angle) * 0.8f, 0.f);
+        s_scales[i] = vec3(1.f + (float)(i % 3), 2.f, 0.5f);
+    }
+
+    const auto batchedTime = measureMicroseconds([](int repeat) {
+        transformsToAffines(s_positions, s_rotations, s_scales, s_batched, ENTITIES_COUNT);
+        s_sink = s_batched[repeat % ENTITIES_COUNT].rows[0].w;
+    });
+    const auto scalarTime = measureMicroseconds([](int repeat) {
+        for (size_t i = 0; i < ENTITIES_COUNT; ++i)
+            s_scalar[i] = transformToAffine(s_positions[i], s_rotations[i], s_scales[i]);
+        s_sink = s_scalar[repeat % ENTITIES_COUNT].rows[0].w;
+    });
+    const auto glmTime = measureMicroseconds([](int repeat) {
+        for (size_t i = 0; i < ENTITIES_COUNT; ++i)
+            s_matrices[i] = translate(mat4(1.f), s_positions[i]) * toMat4(s_rotations[i]) * scale(mat4(1.f), s_scales[i]);
+        s_sink = s_matrices[repeat % ENTITIES_COUNT][3].x;
+    });
+
+    float batchedDifference = 0.f, glmDifference = 0.f;
+    for (size_t i = 0; i < ENTITIES_COUNT; ++i)
+    {
+        const auto matrixRows = transpose(s_matrices[i]);
+        const Affine glmAffine = {{matrixRows[0], matrixRows[1], matrixRows[2]}};
+        batchedDifference = std::max(batchedDifference, affineMaxDifference(s_batched[i], s_scalar[i]));
+        glmDifference = std::max(glmDifference, affineMaxDifference(glmAffine, s_scalar[i]));
+    }
+
+    printf("transforms to affines, %zu entities, simd width %i\n", ENTITIES_COUNT, MATH_SIMD_WIDTH);
+    printf("  batched %8.1f us, max difference to scalar %g\n", batchedTime, batchedDifference);
+    printf("  scalar  %8.1f us\n", scalarTime);
+    printf("  glm     %8.1f us, max difference to scalar %g\n", glmTime, glmDifference);
+
+    CHECK(batchedDifference <= TOLERANCE);
+    CHECK(glmDifference <= TOLERANCE);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,189 @@
+#include "test.hpp"
+
+#include "common/memory.cpp"
+#include "common/range_allocator.hpp"
+
+#include <random>
+
+static Arena s_memory;
+
+static RangeAllocator makeAllocator(u32 size, u32 maxFreeRanges = 16)
+{
+    arenaClear(s_memory);
+    RangeAllocator allocator;
+    rangeAllocatorInit(allocator, size, maxFreeRanges, s_memory);
+    return allocator;
+}
+
+static bool freeRangesAre(RangeAllocator const& allocator, std::initializer_list<Range> expected)
+{
+    if (allocator.freeCount != expected.size())
+        return false;
+    u32 i = 0;
+    for (const auto& range : expected)
+    {
+        const auto& actual = allocator.freeRanges[i++];
+        if (actual.offset != range.offset || actual.size != range.size)
+            return false;
+    }
+    return true;
+}
+
+static void testAllocIsFirstFit()
+{
+    auto allocator = makeAllocator(100);
+    const auto a = rangeAlloc(allocator, 10);
+    const auto b = rangeAlloc(allocator, 20);
+    CHECK(a.offset == 0 && a.size == 10);
+    CHECK(b.offset == 10 && b.size == 20);
+    CHECK(allocator.used == 30);
+
+    rangeFree(allocator, a);
+    CHECK(freeRangesAre(allocator, {{0, 10}, {30, 70}}));
+
+    // too large for the hole at 0, then small enough for it even though the tail is larger
+    const auto large = rangeAlloc(allocator, 15);
+    CHECK(large.offset == 30);
+    const auto small = rangeAlloc(allocator, 5);
+    CHECK(small.offset == 0);
+    CHECK(freeRangesAre(allocator, {{5, 5}, {45, 55}}));
+
+    const auto tooLarge = rangeAlloc(allocator, 56);
+    CHECK(tooLarge.offset == RANGE_ALLOC_FAILED && tooLarge.size == 0);
+    CHECK(allocator.used == 40);
+}
+
+static void testEmptyRanges()
+{
+    auto allocator = makeAllocator(100);
+    const auto empty = rangeAlloc(allocator, 0);
+    CHECK(empty.size == 0 && empty.offset != RANGE_ALLOC_FAILED);
+    CHECK(allocator.used == 0);
+    CHECK(freeRangesAre(allocator, {{0, 100}}));
+
+    CHECK(rangeFree(allocator, empty));
+    CHECK(rangeFree(allocator, {.offset = 50, .size = 0}));
+    CHECK(freeRangesAre(allocator, {{0, 100}}));
+    CHECK(allocator.used == 0);
+}
+
+static void testExactFitRemovesTheFreeRange()
+{
+    auto allocator = makeAllocator(100);
+    const auto a = rangeAlloc(allocator, 10);
+    rangeAlloc(allocator, 10);
+    rangeFree(allocator, a);
+    CHECK(freeRangesAre(allocator, {{0, 10}, {20, 80}}));
+
+    const auto exact = rangeAlloc(allocator, 10);
+    CHECK(exact.offset == 0);
+    CHECK(freeRangesAre(allocator, {{20, 80}}));
+
+    const auto rest = rangeAlloc(allocator, 80);
+    CHECK(rest.offset == 20);
+    CHECK(allocator.freeCount == 0);
+    CHECK(allocator.used == 100);
+    CHECK(rangeAlloc(allocator, 1).offset == RANGE_ALLOC_FAILED);
+}
+
+static void testFreeMergesWithNeighbours()
+{
+    auto allocator = makeAllocator(50);
+    Range ranges[5];
+    for (auto& range : ranges)
+        range = rangeAlloc(allocator, 10);
+    CHECK(allocator.freeCount == 0);
+
+    // no free neighbours
+    rangeFree(allocator, ranges[1]);
+    rangeFree(allocator, ranges[3]);
+    CHECK(freeRangesAre(allocator, {{10, 10}, {30, 10}}));
+
+    // merges with the range before it
+    rangeFree(allocator, ranges[4]);
+    CHECK(freeRangesAre(allocator, {{10, 10}, {30, 20}}));
+
+    // merges with the range after it
+    rangeFree(allocator, ranges[0]);
+    CHECK(freeRangesAre(allocator, {{0, 20}, {30, 20}}));
+
+    // joins the ranges on both sides into one
+    rangeFree(allocator, ranges[2]);
+    CHECK(freeRangesAre(allocator, {{0, 50}}));
+    CHECK(allocator.used == 0);
+}
+
+static void testFreeFailsWhenTheFreeListIsFull()
+{
+    auto allocator = makeAllocator(50, 2);
+    Range ranges[5];
+    for (auto& range : ranges)
+        range = rangeAlloc(allocator, 10);
+
+    CHECK(rangeFree(allocator, ranges[0]));
+    CHECK(rangeFree(allocator, ranges[2]));
+    CHECK(!rangeFree(allocator, ranges[4]));
+    CHECK(freeRangesAre(allocator, {{0, 10}, {20, 10}}));
+    CHECK(allocator.used == 30);
+
+    // merging needs no new entry
+    CHECK(rangeFree(allocator, ranges[1]));
+    CHECK(freeRangesAre(allocator, {{0, 30}}));
+}
+
+static void testRandomAllocationsFreeBackToOneRange()
+{
+    static constexpr u32 SIZE = 100000;
+    static constexpr u32 MAX_LIVE = 4096;
+    auto allocator = makeAllocator(SIZE, MAX_LIVE + 1);
+    auto owned = arenaAlloc<u8>(s_memory, SIZE);
+    auto live = arenaAlloc<Range>(s_memory, MAX_LIVE);
+    u32 liveCount = 0;
+
+    std::mt19937 random(3);
+    bool overlaps = false;
+    for (int step = 0; step < 200000; ++step)
+    {
+        if (liveCount == 0 || (liveCount < MAX_LIVE && random() % 2))
+        {
+            const auto range = rangeAlloc(allocator, random() % 300);
+            if (range.offset == RANGE_ALLOC_FAILED)
+                continue;
+            for (u32 i = range.offset; i < range.offset + range.size; ++i)
+            {
+                overlaps |= owned[i] != 0;
+                owned[i] = 1;
+            }
+            live[liveCount++] = range;
+        }
+        else
+        {
+            const auto index = random() % liveCount;
+            const auto range = live[index];
+            live[index] = live[--liveCount];
+            memset(owned + range.offset, 0, range.size);
+            CHECK(rangeFree(allocator, range));
+        }
+    }
+    CHECK(!overlaps);
+
+    for (u32 i = 0; i < liveCount; ++i)
+        CHECK(rangeFree(allocator, live[i]));
+    CHECK(freeRangesAre(allocator, {{0, SIZE}}));
+    CHECK(allocator.used == 0);
+}
+
+int main()
+{
+    arenaInitGrowable(s_memory, 16 * 1024 * 1024);
+
+    RUN_TEST(testAllocIsFirstFit);
+    RUN_TEST(testEmptyRanges);
+    RUN_TEST(testExactFitRemovesTheFreeRange);
+    RUN_TEST(testFreeMergesWithNeighbours);
+    RUN_TEST(testFreeFailsWhenTheFreeListIsFull);
+    RUN_TEST(testRandomAllocationsFreeBackToOneRange);
+
+    arenaDeinit(s_memory);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,591 @@
+#include "test.hpp"
+
+#include "common/math.cpp"
+#include "common/memory.cpp"
+#include "common/string.cpp"
+#include "renderer.hpp"
+#include "renderer.cpp"
+
+#include <algorithm>
+#include <random>
+
+// the backend independent half of the renderer: state tracking, batching and object variable packing
+
+static Arena s_memory;
+static Arena s_scratch[2];
+static RenderState s_state;
+
+static void resetRenderState()
+{
+    arenaClear(s_memory);
+    s_state = {};
+    mapAlloc(s_state.pipelineStateIds, MAX_PIPELINE_STATES, &s_memory);
+    slotMapInit(s_state.drawCommands, 128, s_memory, "draw commands");
+    renderAllocObjectVariables(s_state, s_memory);
+}
+
+static DrawCommand makeDrawCommand(Mesh& mesh, ShaderType shader = ShaderType::Basic)
+{
+    DrawCommand command = {};
+    command.flags = DrawFlag::Active | DrawFlag::DepthWrite;
+    command.shader = shader;
+    command.mesh = &mesh;
+    command.variables = Shaders::DEFAULT_OBJECT_VARIABLES;
+    return command;
+}
+
+static void testFirstDrawAfterInvalidateChangesEverything()
+{
+    resetRenderState();
+    static Mesh mesh;
+    static Texture texture;
+    auto command = makeDrawCommand(mesh);
+    command.textures[0] = &texture;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        invalidateBoundDrawState(s_state);
+        const auto changes = trackDrawState(s_state, command);
+        CHECK(changes.changes == (DrawStateChange::PipelineState | DrawStateChange::Textures));
+        CHECK(changes.previousPipelineState == NO_PIPELINE_STATE);
+        CHECK(changes.pipelineState == getPipelineState(s_state, command));
+        CHECK(changes.textureSlots == (1u << MAX_TEXTURE_SLOTS) - 1);
+    }
+}
+
+static void testIdenticalDrawsChangeNothing()
+{
+    resetRenderState();
+    static Mesh meshes[2];
+    static Texture texture;
+    auto first = makeDrawCommand(meshes[0]);
+    first.textures[2] = &texture;
+    // meshes live in the shared buffers, switching them rebinds nothing
+    auto second = first;
+    second.mesh = &meshes[1];
+
+    invalidateBoundDrawState(s_state);
+    const auto bound = trackDrawState(s_state, first);
+    for (auto const* command : {&first, &first, &second})
+    {
+        const auto changes = trackDrawState(s_state, *command);
+        CHECK(changes.changes == DrawStateChange::None);
+        CHECK(changes.previousPipelineState == bound.pipelineState);
+        CHECK(changes.pipelineState == bound.pipelineState);
+        CHECK(changes.textureSlots == 0);
+    }
+}
+
+static void testOnlyChangedTextureSlotsRebind()
+{
+    resetRenderState();
+    static Mesh mesh;
+    static Texture textures[3];
+    auto first = makeDrawCommand(mesh);
+    first.textures[0] = &textures[0];
+    first.textures[1] = &textures[1];
+    auto second = first;
+    second.textures[1] = &textures[2];
+    second.textures[3] = &textures[0];
+
+    invalidateBoundDrawState(s_state);
+    trackDrawState(s_state, first);
+    auto changes = trackDrawState(s_state, second);
+    CHECK(changes.changes == DrawStateChange::Textures);
+    CHECK(changes.textureSlots == (1u << 1 | 1u << 3));
+
+    // unbinding a slot is a change too
+    changes = trackDrawState(s_state, first);
+    CHECK(changes.changes == DrawStateChange::Textures);
+    CHECK(changes.textureSlots == (1u << 1 | 1u << 3));
+}
+
+static void testPipelineStateChanges()
+{
+    resetRenderState();
+    static Mesh mesh;
+    const auto solid = makeDrawCommand(mesh);
+    auto wireframe = solid;
+    wireframe.rasterizerState = RasterizerState::Wireframe;
+
+    invalidateBoundDrawState(s_state);
+    const auto first = trackDrawState(s_state, solid);
+    const auto changes = trackDrawState(s_state, wireframe);
+    CHECK(changes.changes == DrawStateChange::PipelineState);
+    CHECK(changes.previousPipelineState == first.pipelineState);
+    CHECK(changes.pipelineState != first.pipelineState);
+    CHECK(changes.textureSlots == 0);
+
+    // the same command drawn instanced needs the instanced variant of its shader
+    const auto instanced = trackDrawState(s_state, wireframe, true);
+    CHECK(instanced.changes == DrawStateChange::PipelineState);
+    CHECK(instanced.pipelineState != changes.pipelineState);
+}
+
+static void testEqualDescsShareAPipelineState()
+{
+    resetRenderState();
+    static Mesh meshes[2];
+    static Texture texture;
+    const auto basic = makeDrawCommand(meshes[0]);
+    // none of these are part of the pipeline state
+    auto other = makeDrawCommand(meshes[1]);
+    other.textures[0] = &texture;
+    other.depth = 10.f;
+    other.variables.objectColor[0] = 0.5f;
+    auto noDepthWrite = basic;
+    noDepthWrite.flags = DrawFlag::Active;
+
+    const auto index = getPipelineState(s_state, basic);
+    CHECK(getPipelineState(s_state, basic) == index);
+    CHECK(getPipelineState(s_state, other) == index);
+    CHECK(s_state.pipelineStatesCount == 1);
+
+    const auto noDepthWriteIndex = getPipelineState(s_state, noDepthWrite);
+    CHECK(noDepthWriteIndex != index);
+    CHECK(getPipelineState(s_state, noDepthWrite) == noDepthWriteIndex);
+    CHECK(s_state.pipelineStatesCount == 2);
+    CHECK(!s_state.pipelineStates[noDepthWriteIndex].depthWrite);
+    CHECK(s_state.pipelineStates[index].shader == ShaderType::Basic);
+}
+
+// each pair differs in one field the other way round from every field below it, so only precedence orders them
+static void testSortKeyFieldPrecedence()
+{
+    static Mesh meshes[2];
+    static Texture textures[2];
+    meshes[1].id = 1;
+
+    // texture pointers hash to their field, find which of the two sorts lower
+    auto lowTextures = makeDrawCommand(meshes[0]);
+    auto highTextures = lowTextures;
+    lowTextures.textures[0] = &textures[0];
+    highTextures.textures[0] = &textures[1];
+    CHECK(getDrawSortKey(lowTextures) != getDrawSortKey(highTextures));
+    if (getDrawSortKey(lowTextures) > getDrawSortKey(highTextures))
+        std::swap(lowTextures, highTextures);
+
+    // pass over shader
+    auto before = makeDrawCommand(meshes[1], ShaderType::Unlit);
+    auto after = makeDrawCommand(meshes[0], ShaderType::Basic);
+    after.flags = DrawFlag::Active;
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+    before = makeDrawCommand(meshes[1], ShaderType::Skybox);
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+
+    // shader over rasterizer state
+    before = makeDrawCommand(meshes[1], ShaderType::Basic);
+    before.rasterizerState = RasterizerState::Wireframe;
+    after = makeDrawCommand(meshes[0], ShaderType::Unlit);
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+
+    // rasterizer state over depth write, the skybox pass holds either
+    before = makeDrawCommand(meshes[1], ShaderType::Skybox);
+    before.flags = DrawFlag::Active;
+    after = makeDrawCommand(meshes[0], ShaderType::Skybox);
+    after.rasterizerState = RasterizerState::Wireframe;
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+
+    // depth write over textures
+    before = highTextures;
+    before.shader = ShaderType::Skybox;
+    after = lowTextures;
+    after.shader = ShaderType::Skybox;
+    after.flags = DrawFlag::Active;
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+
+    // textures over mesh
+    before = lowTextures;
+    before.mesh = &meshes[1];
+    after = highTextures;
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+
+    // mesh over depth
+    before = makeDrawCommand(meshes[0]);
+    before.depth = 100.f;
+    after = makeDrawCommand(meshes[1]);
+    after.depth = 1.f;
+    CHECK(getDrawSortKey(before) < getDrawSortKey(after));
+}
+
+static void testOpaqueDrawsSortFrontToBack()
+{
+    static Mesh mesh;
+    auto command = makeDrawCommand(mesh);
+    const float depths[] = {0.f, 0.01f, 0.5f, 1.f, 1.5f, 10.f, 1000.f, 1e6f};
+    u64 previous = 0;
+    for (size_t i = 0; i < std::size(depths); ++i)
+    {
+        command.depth = depths[i];
+        const auto key = getDrawSortKey(command);
+        CHECK(i == 0 || key > previous);
+        previous = key;
+    }
+
+    // behind the camera counts as at it
+    command.depth = -5.f;
+    const auto behind = getDrawSortKey(command);
+    command.depth = 0.f;
+    CHECK(behind == getDrawSortKey(command));
+}
+
+static void testNoDepthWriteDrawsSortBackToFront()
+{
+    static Mesh mesh;
+    auto command = makeDrawCommand(mesh);
+    command.flags = DrawFlag::Active;
+    const float depths[] = {0.f, 0.01f, 0.5f, 1.f, 1.5f, 10.f, 1000.f, 1e6f};
+    u64 previous = 0;
+    for (size_t i = 0; i < std::size(depths); ++i)
+    {
+        command.depth = depths[i];
+        const auto key = getDrawSortKey(command);
+        CHECK(i == 0 || key < previous);
+        previous = key;
+    }
+}
+
+static void testGeneratedAndLoadedMeshesNeverShareAKey()
+{
+    static Mesh generated, loaded, otherGenerated;
+    generated.flags = MeshFlag::Generated | MeshFlag::Indexed;
+    otherGenerated.flags = generated.flags;
+    loaded.flags = MeshFlag::Indexed;
+    for (size_t id = 0; id < (size_t)GeneratedMesh::Max; ++id)
+    {
+        generated.id = loaded.id = otherGenerated.id = id;
+        CHECK(getDrawSortKey(makeDrawCommand(generated)) != getDrawSortKey(makeDrawCommand(loaded)));
+        CHECK(getDrawSortKey(makeDrawCommand(generated)) == getDrawSortKey(makeDrawCommand(otherGenerated)));
+    }
+}
+
+// the commands stand in for values, their address is their original position
+static void checkRadixSortMatchesStableSort(u64 const* source, size_t count)
+{
+    static DrawCommand slots[1024];
+    ENSURE(count <= std::size(slots));
+
+    auto keys = arenaAlloc<u64>(s_memory, count);
+    auto values = arenaAlloc<DrawCommand const*>(s_memory, count);
+    std::pair<u64, DrawCommand const*> expected[std::size(slots)];
+    for (size_t i = 0; i < count; ++i)
+    {
+        keys[i] = source[i];
+        values[i] = &slots[i];
+        expected[i] = {source[i], &slots[i]};
+    }
+
+    radixSort(keys, values, count, s_memory);
+    std::stable_sort(expected, expected + count, [](auto const& a, auto const& b) { return a.first < b.first; });
+    for (size_t i = 0; i < count; ++i)
+        CHECK(keys[i] == expected[i].first && values[i] == expected[i].second);
+}
+
+static void testRadixSortMatchesStableSort()
+{
+    resetRenderState();
+    std::mt19937_64 random(11);
+    u64 keys[1024];
+
+    // every digit varies
+    for (auto& key : keys)
+        key = random();
+    checkRadixSortMatchesStableSort(keys, std::size(keys));
+
+    // a handful of distinct keys, so most are ties, differing in a few digits so the rest are skipped
+    u64 pool[6];
+    for (auto& key : pool)
+        key = random() & 0x00FF'0000'FF00'0000ull;
+    for (auto& key : keys)
+        key = pool[random() % std::size(pool)];
+    checkRadixSortMatchesStableSort(keys, std::size(keys));
+
+    // all equal, and the short lists renderBuildDrawList does sort
+    for (auto& key : keys)
+        key = pool[0];
+    checkRadixSortMatchesStableSort(keys, std::size(keys));
+    const u64 pair[] = {2, 1};
+    checkRadixSortMatchesStableSort(pair, std::size(pair));
+}
+
+static void testDrawListIsSortedAndSkipsInactive()
+{
+    resetRenderState();
+    static Mesh meshes[3];
+    for (size_t i = 0; i < std::size(meshes); ++i)
+        meshes[i].id = i;
+
+    for (int i = 0; i < 9; ++i)
+    {
+        auto command = makeDrawCommand(meshes[i % 3], i % 2 ? ShaderType::Unlit : ShaderType::Basic);
+        command.depth = (float)(9 - i);
+        if (i == 4)
+            command.flags = DrawFlag::DepthWrite;
+        slotMapInsert(s_state.drawCommands, command);
+    }
+
+    const auto list = renderBuildDrawList(s_state, s_memory);
+    CHECK(list.count == 8);
+    for (size_t i = 0; i < list.count; ++i)
+    {
+        CHECK(bool(list.commands[i]->flags & DrawFlag::Active));
+        CHECK(list.keys[i] == getDrawSortKey(*list.commands[i]));
+        CHECK(i == 0 || list.keys[i - 1] <= list.keys[i]);
+    }
+}
+
+// draw lists are built by hand so each test controls the order batching sees
+static DrawList makeDrawList(DrawCommand const** commands, size_t count)
+{
+    return {.keys = nullptr, .commands = commands, .count = count};
+}
+
+static void testRunsSplitOnDrawState()
+{
+    resetRenderState();
+    static Mesh meshes[2];
+    static Texture texture;
+    const auto base = makeDrawCommand(meshes[0]);
+    auto otherMesh = base;
+    otherMesh.mesh = &meshes[1];
+    auto otherTextures = base;
+    otherTextures.textures[4] = &texture;
+    auto otherRasterizer = base;
+    otherRasterizer.rasterizerState = RasterizerState::Wireframe;
+    auto noDepthWrite = base;
+    noDepthWrite.flags = DrawFlag::Active;
+
+    for (auto const* other : {&otherMesh, &otherTextures, &otherRasterizer, &noDepthWrite})
+    {
+        DrawCommand const* commands[] = {&base, &base, other, other, other};
+        const auto batches = renderBuildDrawBatches(makeDrawList(commands, std::size(commands)), s_memory);
+        CHECK(batches.count == 2);
+        CHECK(batches.batches[0].first == 0 && batches.batches[0].count == 2 && batches.batches[0].instanced);
+        CHECK(batches.batches[1].first == 2 && batches.batches[1].count == 3 && batches.batches[1].instanced);
+        CHECK(batches.batches[1].firstInstance == 2);
+        CHECK(batches.instancesCount == 5);
+    }
+
+    // a run of one is a plain draw
+    DrawCommand const* commands[] = {&base, &otherMesh, &base};
+    const auto batches = renderBuildDrawBatches(makeDrawList(commands, std::size(commands)), s_memory);
+    CHECK(batches.count == 3);
+    for (size_t i = 0; i < batches.count; ++i)
+        CHECK(batches.batches[i].first == i && batches.batches[i].count == 1 && !batches.batches[i].instanced);
+    CHECK(batches.instancesCount == 0);
+}
+
+static void testSkyboxIsNeverMerged()
+{
+    resetRenderState();
+    static Mesh mesh;
+    const auto skybox = makeDrawCommand(mesh, ShaderType::Skybox);
+
+    DrawCommand const* commands[] = {&skybox, &skybox, &skybox};
+    const auto batches = renderBuildDrawBatches(makeDrawList(commands, std::size(commands)), s_memory);
+    CHECK(batches.count == 3);
+    for (size_t i = 0; i < batches.count; ++i)
+        CHECK(batches.batches[i].first == i && batches.batches[i].count == 1 && !batches.batches[i].instanced);
+    CHECK(batches.instancesCount == 0);
+}
+
+// a run of firstCount draws of one mesh followed by secondCount of another
+static DrawList makeTwoRunDrawList(size_t firstCount, size_t secondCount)
+{
+    static Mesh meshes[2];
+    static const auto first = makeDrawCommand(meshes[0]);
+    static const auto second = makeDrawCommand(meshes[1]);
+
+    const auto count = firstCount + secondCount;
+    auto commands = arenaAlloc<DrawCommand const*>(s_memory, count);
+    for (size_t i = 0; i < count; ++i)
+        commands[i] = i < firstCount ? &first : &second;
+    return makeDrawList(commands, count);
+}
+
+static void testRunsPastMaxInstancesAreSplit()
+{
+    resetRenderState();
+
+    // the first run leaves room for two more instances, the second run instances that many and draws the rest
+    auto batches = renderBuildDrawBatches(makeTwoRunDrawList(MAX_INSTANCES - 2, 3), s_memory);
+    CHECK(batches.count == 3);
+    CHECK(batches.batches[0].count == MAX_INSTANCES - 2 && batches.batches[0].instanced);
+    CHECK(batches.batches[1].first == MAX_INSTANCES - 2 && batches.batches[1].count == 2);
+    CHECK(batches.batches[1].instanced && batches.batches[1].firstInstance == MAX_INSTANCES - 2);
+    CHECK(batches.batches[2].first == MAX_INSTANCES && batches.batches[2].count == 1 && !batches.batches[2].instanced);
+    CHECK(batches.instancesCount == MAX_INSTANCES);
+
+    // room for one is too little for any part of the second run
+    resetRenderState();
+    batches = renderBuildDrawBatches(makeTwoRunDrawList(MAX_INSTANCES - 1, 3), s_memory);
+    CHECK(batches.count == 4);
+    CHECK(batches.batches[0].count == MAX_INSTANCES - 1 && batches.batches[0].instanced);
+    for (u32 i = 1; i < 4; ++i)
+    {
+        const auto& batch = batches.batches[i];
+        CHECK(batch.first == MAX_INSTANCES - 1 + i - 1 && batch.count == 1 && !batch.instanced);
+    }
+    CHECK(batches.instancesCount == MAX_INSTANCES - 1);
+
+    // a run longer than the whole buffer fills it and draws what's left singly
+    resetRenderState();
+    batches = renderBuildDrawBatches(makeTwoRunDrawList(MAX_INSTANCES + 2, 0), s_memory);
+    CHECK(batches.count == 3);
+    CHECK(batches.batches[0].first == 0 && batches.batches[0].count == MAX_INSTANCES && batches.batches[0].instanced);
+    CHECK(batches.batches[1].first == MAX_INSTANCES && batches.batches[1].count == 1 && !batches.batches[1].instanced);
+    CHECK(batches.batches[2].first == MAX_INSTANCES + 1 && batches.batches[2].count == 1);
+    CHECK(batches.instancesCount == MAX_INSTANCES);
+}
+
+static void testInstancesFollowListOrder()
+{
+    resetRenderState();
+    static Mesh mesh;
+    DrawCommand draws[4];
+    DrawCommand const* commands[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        draws[i] = makeDrawCommand(mesh);
+        draws[i].variables.world[2][3] = (float)i;
+        draws[i].variables.objectColor[1] = (float)i * 0.25f;
+    }
+    // not the order the commands are stored in
+    for (int i = 0; i < 4; ++i)
+        commands[i] = &draws[3 - i];
+
+    const auto batches = renderBuildDrawBatches(makeDrawList(commands, std::size(commands)), s_memory);
+    CHECK(batches.count == 1 && batches.batches[0].instanced && batches.batches[0].count == 4);
+    CHECK(batches.instancesCount == 4);
+    for (size_t i = 0; i < batches.instancesCount; ++i)
+    {
+        const auto& instance = batches.instances[i];
+        const auto& variables = commands[i]->variables;
+        CHECK(memcmp(instance.world, variables.world, sizeof(instance.world)) == 0);
+        CHECK(memcmp(instance.objectColor, variables.objectColor, sizeof(instance.objectColor)) == 0);
+        CHECK(instance.world[2][3] == (float)(3 - i));
+    }
+}
+
+static Shaders::ObjectVariables const& packedVariables(u32 block)
+{
+    return *(Shaders::ObjectVariables const*)(s_state.objectVariables + (size_t)block * Shaders::OBJECT_VARIABLES_BLOCK_SIZE);
+}
+
+// one run of blocks [begin, end) is all that is dirty
+static bool dirtyIsOneRun(u32 begin, u32 end)
+{
+    const auto dirty = renderGetDirtyObjectVariables(s_state, s_memory);
+    return dirty.count == 1 && dirty.runs[0].begin == begin && dirty.runs[0].end == end;
+}
+
+static bool nothingDirty()
+{
+    return renderGetDirtyObjectVariables(s_state, s_memory).count == 0;
+}
+
+static void testPackCopiesDirtyVariablesIntoTheirBlocks()
+{
+    resetRenderState();
+    static Mesh mesh;
+    Handle<DrawCommand> handles[10];
+    for (auto& handle : handles)
+        handle = pushDrawCmd(s_state, mesh);
+
+    renderPackObjectVariables(s_state);
+    CHECK(dirtyIsOneRun(0, 10));
+    for (auto handle : handles)
+    {
+        const auto& command = *slotMapGet(s_state.drawCommands, handle);
+        CHECK(!command.variablesDirty);
+        CHECK(memcmp(&packedVariables(command.variablesBlock), &command.variables, sizeof(command.variables)) == 0);
+    }
+
+    renderObjectVariablesUploaded(s_state);
+    CHECK(nothingDirty());
+
+    // nothing changed since the upload
+    renderPackObjectVariables(s_state);
+    CHECK(nothingDirty());
+
+    auto& changed = *slotMapGet(s_state.drawCommands, handles[7]);
+    setShaderVariable(changed, ShaderSlot::ObjectColor, vec4(0.5f, 0.f, 0.f, 1.f));
+    renderPackObjectVariables(s_state);
+    CHECK(dirtyIsOneRun(changed.variablesBlock, changed.variablesBlock + 1));
+    CHECK(packedVariables(changed.variablesBlock).objectColor[0] == 0.5f);
+}
+
+static void testDirtyBlocksCoalesceIntoRuns()
+{
+    resetRenderState();
+    static Mesh mesh;
+    Handle<DrawCommand> handles[100];
+    for (auto& handle : handles)
+        handle = pushDrawCmd(s_state, mesh);
+    renderPackObjectVariables(s_state);
+    renderObjectVariablesUploaded(s_state);
+
+    auto change = [&](u32 block) {
+        setShaderVariable(*slotMapGet(s_state.drawCommands, handles[block]), ShaderSlot::ObjectColor, vec4(1.f));
+    };
+    // a gap the run bridges, one just too wide, and the last blocks of one bit word and the first of the next
+    const u32 gap = OBJECT_VARIABLES_RUN_GAP;
+    change(3);
+    change(3 + gap + 1);
+    change(30);
+    change(30 + gap + 2);
+    change(63);
+    change(64);
+    change(99);
+    renderPackObjectVariables(s_state);
+
+    const auto dirty = renderGetDirtyObjectVariables(s_state, s_memory);
+    const ObjectVariablesRun expected[] = {{3, 3 + gap + 2}, {30, 31}, {30 + gap + 2, 30 + gap + 3}, {63, 65}, {99, 100}};
+    CHECK(dirty.count == std::size(expected));
+    for (size_t i = 0; i < std::min(dirty.count, std::size(expected)); ++i)
+        CHECK(dirty.runs[i].begin == expected[i].begin && dirty.runs[i].end == expected[i].end);
+
+    // a frame that wasn't uploaded keeps its blocks dirty
+    change(50);
+    renderPackObjectVariables(s_state);
+    CHECK(renderGetDirtyObjectVariables(s_state, s_memory).count == std::size(expected) + 1);
+    CHECK(packedVariables(50).objectColor[0] == 1.f);
+
+    renderObjectVariablesUploaded(s_state);
+    CHECK(nothingDirty());
+
+    // a new gpu copy takes every block, and only the blocks that exist
+    renderMarkObjectVariablesDirty(s_state);
+    CHECK(dirtyIsOneRun(0, (u32)s_state.drawCommands.capacity));
+}
+
+int main()
+{
+    arenaInitGrowable(s_memory, 64 * 1024 * 1024);
+    arenaInitGrowable(s_scratch[0], 64 * 1024 * 1024);
+    arenaInitGrowable(s_scratch[1], 64 * 1024 * 1024);
+    arenaScratchInit(s_scratch[0], s_scratch[1]);
+
+    RUN_TEST(testFirstDrawAfterInvalidateChangesEverything);
+    RUN_TEST(testIdenticalDrawsChangeNothing);
+    RUN_TEST(testOnlyChangedTextureSlotsRebind);
+    RUN_TEST(testPipelineStateChanges);
+    RUN_TEST(testEqualDescsShareAPipelineState);
+    RUN_TEST(testSortKeyFieldPrecedence);
+    RUN_TEST(testOpaqueDrawsSortFrontToBack);
+    RUN_TEST(testNoDepthWriteDrawsSortBackToFront);
+    RUN_TEST(testGeneratedAndLoadedMeshesNeverShareAKey);
+    RUN_TEST(testRadixSortMatchesStableSort);
+    RUN_TEST(testDrawListIsSortedAndSkipsInactive);
+    RUN_TEST(testRunsSplitOnDrawState);
+    RUN_TEST(testSkyboxIsNeverMerged);
+    RUN_TEST(testRunsPastMaxInstancesAreSplit);
+    RUN_TEST(testInstancesFollowListOrder);
+    RUN_TEST(testPackCopiesDirtyVariablesIntoTheirBlocks);
+    RUN_TEST(testDirtyBlocksCoalesceIntoRuns);
+
+    arenaDeinit(s_scratch[1]);
+    arenaDeinit(s_scratch[0]);
+    arenaDeinit(s_memory);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
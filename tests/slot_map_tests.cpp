@@ -0,0 +1,136 @@
+#include "test.hpp"
+
+#include "common/memory.cpp"
+#include "common/slot_map.hpp"
+
+static Arena s_memory;
+
+struct Value
+{
+    u32 id;
+};
+
+static SlotMap<Value> makeSlotMap(size_t capacity)
+{
+    arenaClear(s_memory);
+    SlotMap<Value> map;
+    slotMapInit(map, capacity, s_memory);
+    return map;
+}
+
+static void testInsertAndGet()
+{
+    auto map = makeSlotMap(8);
+    CHECK(!slotMapGet(map, Handle<Value>{}));
+
+    const auto a = slotMapInsert(map, {.id = 1});
+    const auto b = slotMapInsert(map, {.id = 2});
+    CHECK(a && b && a != b);
+    CHECK(map.size == 2);
+    CHECK(slotMapGet(map, a)->id == 1);
+    CHECK(slotMapGet(map, b)->id == 2);
+    CHECK(slotMapHandleAt(map, 0) == a);
+    CHECK(slotMapHandleAt(map, 1) == b);
+}
+
+static void testErasedHandlesGoStale()
+{
+    auto map = makeSlotMap(8);
+    const auto a = slotMapInsert(map, {.id = 1});
+    CHECK(slotMapErase(map, a));
+    CHECK(!slotMapContains(map, a));
+    CHECK(!slotMapErase(map, a));
+    CHECK(map.size == 0);
+
+    // the slot comes back with a new generation, the old handle must not see the new value
+    const auto b = slotMapInsert(map, {.id = 2});
+    CHECK(handleIndex(b) == handleIndex(a));
+    CHECK(b != a);
+    CHECK(!slotMapGet(map, a));
+    CHECK(slotMapGet(map, b)->id == 2);
+}
+
+static void testEraseSwapsTheLastValueIn()
+{
+    auto map = makeSlotMap(8);
+    Handle<Value> handles[4];
+    for (u32 i = 0; i < 4; ++i)
+        handles[i] = slotMapInsert(map, {.id = i});
+
+    CHECK(slotMapErase(map, handles[1]));
+    CHECK(map.size == 3);
+    CHECK(map[0].id == 0 && map[1].id == 3 && map[2].id == 2);
+    CHECK(slotMapHandleAt(map, 1) == handles[3]);
+    for (u32 i : {0u, 2u, 3u})
+        CHECK(slotMapGet(map, handles[i])->id == i);
+
+    // erasing the last value moves nothing
+    CHECK(slotMapErase(map, handles[2]));
+    CHECK(map.size == 2);
+    CHECK(map[0].id == 0 && map[1].id == 3);
+    CHECK(slotMapGet(map, handles[3])->id == 3);
+
+    u32 count = 0;
+    for (const auto& value : map)
+        count += value.id == 0 || value.id == 3;
+    CHECK(count == 2);
+}
+
+static void testFreedSlotsAreReusedOldestFirst()
+{
+    auto map = makeSlotMap(8);
+    Handle<Value> handles[4];
+    for (u32 i = 0; i < 4; ++i)
+        handles[i] = slotMapInsert(map, {.id = i});
+
+    slotMapErase(map, handles[2]);
+    slotMapErase(map, handles[0]);
+    slotMapErase(map, handles[3]);
+    CHECK(handleIndex(slotMapInsert(map, {})) == handleIndex(handles[2]));
+    CHECK(handleIndex(slotMapInsert(map, {})) == handleIndex(handles[0]));
+
+    // a slot freed now queues behind the one still waiting
+    slotMapErase(map, handles[1]);
+    CHECK(handleIndex(slotMapInsert(map, {})) == handleIndex(handles[3]));
+    CHECK(handleIndex(slotMapInsert(map, {})) == handleIndex(handles[1]));
+    CHECK(handleIndex(slotMapInsert(map, {})) == 4);
+}
+
+static void testExhaustedSlotsAreRetired()
+{
+    auto map = makeSlotMap(2);
+    const auto first = slotMapInsert(map, {.id = 0});
+    auto handle = first;
+    bool staleResolved = false;
+    for (u32 generation = 1; generation < HANDLE_GENERATION_MASK; ++generation)
+    {
+        slotMapErase(map, handle);
+        handle = slotMapInsert(map, {.id = generation});
+        CHECK(handleIndex(handle) == handleIndex(first));
+        staleResolved |= slotMapContains(map, first);
+    }
+    CHECK(!staleResolved);
+    CHECK(handleGeneration(handle) == HANDLE_GENERATION_MASK);
+
+    // the last generation is not wrapped around to one an old handle may still hold
+    slotMapErase(map, handle);
+    const auto next = slotMapInsert(map, {.id = 7});
+    CHECK(handleIndex(next) != handleIndex(first));
+    for (u32 generation = 0; generation <= HANDLE_GENERATION_MASK; ++generation)
+        CHECK(!slotMapGet(map, makeHandle<Value>(handleIndex(first), generation)));
+    CHECK(slotMapGet(map, next)->id == 7);
+}
+
+int main()
+{
+    arenaInitGrowable(s_memory, 1024 * 1024);
+
+    RUN_TEST(testInsertAndGet);
+    RUN_TEST(testErasedHandlesGoStale);
+    RUN_TEST(testEraseSwapsTheLastValueIn);
+    RUN_TEST(testFreedSlotsAreReusedOldestFirst);
+    RUN_TEST(testExhaustedSlotsAreRetired);
+
+    arenaDeinit(s_memory);
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,133 @@
+#include "test.hpp"
+
+#include "common/memory.cpp"
+#include "common/string.cpp"
+
+#include <random>
+
+// the block kernels in string.cpp against plain loops. haystacks sit at varying alignments between guard bytes
+// made of the needle's chars, so a kernel that reads past either end finds a match that isn't there
+
+static ptrdiff_t referenceFind(String haystack, String needle)
+{
+    for (size_t i = 0; i + needle.length <= haystack.length; ++i)
+        if (memcmp(haystack.data + i, needle.data, needle.length) == 0)
+            return (ptrdiff_t)i;
+    return STR_NOT_FOUND;
+}
+
+static ptrdiff_t referenceFindReverse(String haystack, String needle)
+{
+    for (size_t i = haystack.length - needle.length + 1; i-- > 0;)
+        if (memcmp(haystack.data + i, needle.data, needle.length) == 0)
+            return (ptrdiff_t)i;
+    return STR_NOT_FOUND;
+}
+
+static ptrdiff_t referenceFindFirst(String haystack, String set, bool inSet)
+{
+    for (size_t i = 0; i < haystack.length; ++i)
+        if (s_isInSet(haystack[i], set) == inSet)
+            return (ptrdiff_t)i;
+    return STR_NOT_FOUND;
+}
+
+static ptrdiff_t referenceFindLastNotOf(String haystack, String set)
+{
+    for (size_t i = haystack.length; i-- > 0;)
+        if (!s_isInSet(haystack[i], set))
+            return (ptrdiff_t)i;
+    return STR_NOT_FOUND;
+}
+
+static constexpr size_t GUARD_SIZE = 64;
+static constexpr size_t MAX_LENGTH = 200;
+static char s_buffer[GUARD_SIZE + MAX_LENGTH + GUARD_SIZE + 32];
+
+// fills a haystack of the given length at the given misalignment, surrounded by copies of the needle
+static String makeHaystack(std::mt19937& random, size_t length, size_t alignment, String needle, String alphabet)
+{
+    for (size_t i = 0; i < sizeof(s_buffer); ++i)
+        s_buffer[i] = needle[i % needle.length];
+    const String haystack = {.data = s_buffer + GUARD_SIZE + alignment, .length = length};
+    for (size_t i = 0; i < length; ++i)
+        haystack.data[i] = alphabet[random() % alphabet.length];
+    return haystack;
+}
+
+static void checkAllKernels(String haystack, String needle)
+{
+    if (haystack.length >= needle.length)
+    {
+        CHECK(s_findSubstring(haystack.data, haystack.length, needle) == referenceFind(haystack, needle));
+        CHECK(s_findSubstringReverse(haystack.data, haystack.length, needle) == referenceFindReverse(haystack, needle));
+    }
+    CHECK(s_findFirstNotOf(haystack.data, haystack.length, needle) == referenceFindFirst(haystack, needle, false));
+    CHECK(s_findFirstOf(haystack.data, haystack.length, needle) == referenceFindFirst(haystack, needle, true));
+    CHECK(s_findLastNotOf(haystack.data, haystack.length, needle) == referenceFindLastNotOf(haystack, needle));
+    if (needle.length == 1)
+    {
+        CHECK(s_findByte(haystack.data, haystack.length, needle[0]) == referenceFind(haystack, needle));
+        CHECK(s_findByteReverse(haystack.data, haystack.length, needle[0]) == referenceFindReverse(haystack, needle));
+    }
+}
+
+static void testKernelsMatchScalarAtEveryTail()
+{
+    std::mt19937 random(11);
+    const auto alphabet = strL("abcab  \t");
+    const String needles[] = {strL("a"), strL(" "), strL("ab"), strL("abc"), strL("b a"), strL(" \t"), strL("cabab")};
+    for (const auto& needle : needles)
+        for (size_t length = 0; length <= 130; ++length)
+            for (size_t alignment = 0; alignment < 32; alignment += 7)
+                for (int round = 0; round < 4; ++round)
+                    checkAllKernels(makeHaystack(random, length, alignment, needle, alphabet), needle);
+}
+
+// one match per haystack placed across every position, so each straddles block boundaries in every possible way
+static void testMatchesAcrossBlockBoundaries()
+{
+    std::mt19937 random(5);
+    const String needles[] = {strL("x"), strL("xy"), strL("xyz"), strL("xyzzy-with-a-long-tail-past-one-block")};
+    for (const auto& needle : needles)
+        for (size_t length : {needle.length, (size_t)33, (size_t)64, (size_t)97, (size_t)160})
+        {
+            if (length < needle.length)
+                continue;
+            for (size_t position = 0; position + needle.length <= length; ++position)
+            {
+                auto haystack = makeHaystack(random, length, position % 3, strL("q"), strL("xyz"));
+                // no other full copy of the needle can form from the guard or the filler
+                memset(haystack.data, 'z', length);
+                memcpy(haystack.data + position, needle.data, needle.length);
+                CHECK(s_findSubstring(haystack.data, haystack.length, needle) == (ptrdiff_t)position);
+                CHECK(s_findSubstringReverse(haystack.data, haystack.length, needle) == (ptrdiff_t)position);
+                checkAllKernels(haystack, needle);
+            }
+        }
+}
+
+static void testNeedlesLongerThanTheHaystack()
+{
+    const auto haystack = strL("abcabc");
+    const auto needle = strL("abcabca");
+    CHECK(!strFind(haystack, needle));
+    CHECK(!strFindReverse(haystack, needle));
+    CHECK(!strFindNot(haystack, needle));
+    CHECK(!strFindNotReverse(haystack, needle));
+    CHECK(!strFind(String{}, strL("a")));
+    CHECK(!strFind(haystack, String{}));
+
+    // equal lengths are still searched
+    CHECK(strFind(haystack, haystack).data == haystack.data);
+    CHECK(strFindReverse(haystack, haystack).data == haystack.data);
+}
+
+int main()
+{
+    RUN_TEST(testKernelsMatchScalarAtEveryTail);
+    RUN_TEST(testMatchesAcrossBlockBoundaries);
+    RUN_TEST(testNeedlesLongerThanTheHaystack);
+
+    return g_testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
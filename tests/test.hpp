@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "platform.hpp"
+
+// each test executable is a single translation unit that includes the sources it covers, like game.cpp does.
+// checks keep going after a failure so one run reports everything that broke
+inline int g_testFailures = 0;
+
+#define CHECK(x)                                                                  \
+    do                                                                            \
+    {                                                                             \
+        if (!(x))                                                                 \
+        {                                                                         \
+            fprintf(stderr, "%s:%i: check failed: %s\n", __FILE__, __LINE__, #x); \
+            g_testFailures++;                                                     \
+        }                                                                         \
+    } while (0)
+
+#define RUN_TEST(test)                                                              \
+    do                                                                              \
+    {                                                                               \
+        const auto failures = g_testFailures;                                       \
+        test();                                                                     \
+        printf("%s %s\n", g_testFailures == failures ? "passed" : "FAILED", #test); \
+    } while (0)
+
+// arenas only need plain heap memory here, the platform layer isn't linked into tests
+namespace Platform
+{
+
+void* allocMemory(size_t size, void*)
+{
+    return calloc(1, size);
+}
+
+void* reserveMemory(size_t size, void*)
+{
+    return calloc(1, size);
+}
+
+bool commitMemory(void*, size_t)
+{
+    return true;
+}
+
+void decommitMemory(void*, size_t)
+{
+}
+
+void freeMemory(void* addr, size_t)
+{
+    free(addr);
+}
+
+size_t getPageSize()
+{
+    return 4096;
+}
+
+}  // namespace Platform